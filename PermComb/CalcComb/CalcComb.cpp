@@ -5,17 +5,42 @@
 #include "../permcomb/concurrent_comb.h"
 #include "../common/timer.h"
 
+#if defined(__SIZEOF_INT128__)
+// so the tests can print an unsigned __int128 int_type
+std::ostream& operator<<(std::ostream& os, concurrent_permcomb::uint128_type value)
+{
+	return os << concurrent_permcomb::to_str(value);
+}
+#endif
+
 void test_find_comb(uint32_t fullset, uint32_t subset);
 void unit_test();
 void unit_test_threaded();
 void unit_test_threaded_predicate();
 void unit_test_threaded_shard();
+void unit_test_threaded_chunked();
+void unit_test_threaded_pool();
+void unit_test_threaded_batched();
+void unit_test_threaded_cancel();
+void unit_test_threaded_idx();
+void unit_test_threaded_state();
+void unit_test_next_comb_with_state();
+void unit_test_threaded_mask();
+void unit_test_threaded_revdoor();
+void unit_test_threaded_multichoose();
+void unit_test_threaded_subsets();
+void unit_test_threaded_multiset();
+void unit_test_threaded_pruned();
 void unit_test_comb_by_idx();
+void unit_test_rank_comb();
+void unit_test_total_comb();
+void unit_test_comb_past_int64();
 void usage_of_comb_by_idx();
 void usage_of_next_comb();
 void usage_of_next_comb_with_state();
 void usage_of_comb_state_by_idx();
 void benchmark_comb();
+void benchmark_comb_idx();
 
 template<typename T>
 bool compare_vec(T& results1, T& results2)
@@ -254,146 +279,1255 @@ bool test_threaded_comb_shard(int_type thread_cnt, uint32_t fullset_size, uint32
 	return true;
 }
 
-// return false to stop processing
-template<typename container_type>
-struct empty_callback_t
+template<typename int_type>
+bool test_threaded_comb_chunked(int_type thread_cnt, int_type chunk_cnt, uint32_t fullset_size, uint32_t subset_size)
 {
-	bool operator()(const int thread_index, const size_t fullset_size, const container_type& cont)
+	std::cout << "test_threaded_comb_chunked(" << thread_cnt << ", " << chunk_cnt << ", " << fullset_size << ", " << subset_size << ") starting" << std::endl;
+
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+
+	std::vector<std::vector< std::vector<uint32_t> > > vecvecvec((size_t)thread_cnt);
+
+	concurrent_comb::compute_all_comb_chunked(thread_cnt, chunk_cnt, subset_size, fullset,
+		[&vecvecvec](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont) -> bool
 	{
+		vecvecvec[(size_t)thread_index].push_back(cont);
 		return true;
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont,
+			const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector< std::vector<uint32_t> > vecvec;
+	do
+	{
+		vecvec.push_back(std::vector<uint32_t>(subset.begin(), subset.end()));
+	} while (stdcomb::next_combination(fullset.begin(), fullset.end(), subset.begin(), subset.end()));
+
+	// chunks are claimed in any order, so compare the sorted results
+	std::vector< std::vector<uint32_t> > all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
 	}
-};
+	std::sort(all_results.begin(), all_results.end());
 
-template<typename container_type>
-struct error_callback_t
-{
-	void operator()(const int thread_index, const size_t fullset_size, const container_type& cont, const std::string& error)
+	bool error = (all_results != vecvec);
+	if (error)
 	{
-		std::cerr << error << std::endl;
+		std::cout << "Chunked results count " << all_results.size() << " differs from " << vecvec.size() << std::endl;
 	}
-};
+	std::cout << "test_threaded_comb_chunked(" << thread_cnt << ", " << chunk_cnt << ", " << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
 
-//typedef boost::multiprecision::cpp_int int_type;
-//typedef boost::multiprecision::int128_t int_type;
-typedef int64_t int_type;
+	return !error;
+}
 
-int main(int argc, char* argv[])
+template<typename int_type>
+bool test_threaded_comb_pool(concurrent_permcomb::thread_pool& pool, int_type thread_cnt, uint32_t fullset_size, uint32_t subset_size)
 {
-	//benchmark_comb();
+	std::cout << "test_threaded_comb_pool(" << thread_cnt << ", " << fullset_size << ", " << subset_size << ") starting" << std::endl;
 
-	//unit_test();
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
 
-	//unit_test_threaded();
+	std::vector<std::vector< std::vector<uint32_t> > > vecvecvec((size_t)thread_cnt);
 
-	//unit_test_threaded_predicate();
+	concurrent_comb::compute_all_comb(pool, thread_cnt, subset_size, fullset,
+		[&vecvecvec](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont) -> bool
+	{
+		vecvecvec[(size_t)thread_index].push_back(cont);
+		return true;
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont,
+			const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
 
-	//unit_test_threaded_shard();
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector< std::vector<uint32_t> > vecvec;
+	do
+	{
+		vecvec.push_back(std::vector<uint32_t>(subset.begin(), subset.end()));
+	} while (stdcomb::next_combination(fullset.begin(), fullset.end(), subset.begin(), subset.end()));
 
-	//unit_test_comb_by_idx();
+	// compare results
+	size_t cnt = 0;
+	bool error = false;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		for (size_t j = 0; j < vecvecvec[i].size(); ++j, ++cnt)
+		{
+			if (!compare_vec(vecvec[cnt], vecvecvec[i][j]))
+			{
+				error = true;
 
-	//usage_of_next_comb();
+				std::cout << "Comb at " << cnt << " is not the same!" << std::endl;
 
-	//usage_of_next_comb_with_state();
+				display(vecvec[cnt]);
+				display(vecvecvec[i][j]);
 
-	//usage_of_comb_by_idx();
+				return false;
+			}
+		}
+	}
+	if (cnt != vecvec.size())
+	{
+		error = true;
+		std::cout << "Comb count " << cnt << " is not " << vecvec.size() << std::endl;
+	}
 
-	usage_of_comb_state_by_idx();
+	std::cout << "test_threaded_comb_pool(" << thread_cnt << ", " << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
 
-	return 0;
+	return !error;
 }
 
-void benchmark_comb()
+template<typename int_type>
+bool test_threaded_comb_batched(int_type thread_cnt, uint32_t block_size, uint32_t fullset_size, uint32_t subset_size)
 {
-	std::vector<int> fullset_vec(20);
-	std::iota(fullset_vec.begin(), fullset_vec.end(), 0);
-	uint32_t subset = 10;
+	std::cout << "test_threaded_comb_batched(" << thread_cnt << ", " << block_size << ", " << fullset_size << ", " << subset_size << ") starting" << std::endl;
 
-	timer stopwatch;
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector< std::vector<uint32_t> > vecvec;
+	do
 	{
-		std::vector<int> fullset_vec2(fullset_vec.begin(), fullset_vec.end());
-		std::vector<int> subset_vec(fullset_vec.begin(), fullset_vec.begin()+ subset);
+		vecvec.push_back(std::vector<uint32_t>(subset.begin(), subset.end()));
+	} while (stdcomb::next_combination(fullset.begin(), fullset.end(), subset.begin(), subset.end()));
 
-		stopwatch.start("next_combination");
-		while (stdcomb::next_combination(fullset_vec2.begin(), fullset_vec2.end(), subset_vec.begin(), subset_vec.end()))
-		{
+	// every combination is stored at its rank, so threads never write the same slot
+	std::vector< std::vector<uint32_t> > batched_results(vecvec.size());
 
+	concurrent_comb::compute_all_comb_batched(thread_cnt, block_size, subset_size, fullset,
+		[&batched_results](const int thread_index,
+			const size_t fullset_cnt,
+			const uint32_t* block,
+			size_t block_cnt,
+			uint32_t subset_cnt,
+			const int_type& block_start_index) -> bool
+	{
+		for (size_t i = 0; i < block_cnt; ++i)
+		{
+			const uint32_t* comb = block + i * subset_cnt;
+			batched_results[static_cast<size_t>(block_start_index) + i].assign(comb, comb + subset_cnt);
 		}
-		stopwatch.stop();
+		return true;
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont,
+			const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	bool error = (batched_results != vecvec);
+	if (error)
+	{
+		std::cout << "Batched results differ from stdcomb::next_combination" << std::endl;
 	}
+	std::cout << "test_threaded_comb_batched(" << thread_cnt << ", " << block_size << ", " << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
 
+	return !error;
+}
 
-	int_type thread_cnt = 1;
+// Search for the combination at target_index and check that finding it
+// stops all threads early
+template<typename int_type>
+bool test_threaded_comb_idx(int_type thread_cnt, const std::vector<uint32_t>& fullset, uint32_t subset_size)
+{
+	std::cout << "test_threaded_comb_idx(" << thread_cnt << ", " << fullset.size() << ", " << subset_size << ") starting" << std::endl;
 
-	typedef empty_callback_t<decltype(fullset_vec)> callback_t;
-	typedef error_callback_t<decltype(fullset_vec)> err_callback_t;
+	typedef concurrent_permcomb::index_view<std::vector<uint32_t>, uint32_t> view_type;
+	std::vector<std::vector< std::vector<uint32_t> > > vecvecvec((size_t)thread_cnt);
 
-	stopwatch.start("1 thread(s)");
-	thread_cnt = 1;
-	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
-	stopwatch.stop();
+	concurrent_comb::compute_all_comb_idx(thread_cnt, subset_size, fullset,
+		[&vecvecvec](const int thread_index,
+			const size_t fullset_cnt,
+			const view_type& view) -> bool
+	{
+		std::vector<uint32_t> comb;
+		for (size_t i = 0; i < view.size(); ++i)
+		{
+			comb.push_back(view[i]);
+		}
+		vecvecvec[(size_t)thread_index].push_back(comb);
+		return true;
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont,
+			const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
 
-	stopwatch.start("2 thread(s)");
-	thread_cnt = 2;
-	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
-	stopwatch.stop();
+	// combinations of positions, mapped to the elements
+	std::vector<uint32_t> positions(fullset.size());
+	std::iota(positions.begin(), positions.end(), 0);
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector< std::vector<uint32_t> > vecvec;
+	do
+	{
+		std::vector<uint32_t> comb;
+		for (size_t i = 0; i < subset.size(); ++i)
+		{
+			comb.push_back(fullset[subset[i]]);
+		}
+		vecvec.push_back(comb);
+	} while (stdcomb::next_combination(positions.begin(), positions.end(), subset.begin(), subset.end()));
 
-	stopwatch.start("3 thread(s)");
-	thread_cnt = 3;
-	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
-	stopwatch.stop();
+	std::vector< std::vector<uint32_t> > all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
 
-	stopwatch.start("4 thread(s)");
-	thread_cnt = 4;
-	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
-	stopwatch.stop();
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cout << "Index combination count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	std::cout << "test_threaded_comb_idx(" << thread_cnt << ", " << fullset.size() << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
 }
 
-void test_find_comb(uint32_t fullset, uint32_t subset)
+// element type without operator== for test_threaded_comb_state
+struct no_equal_t
 {
-	std::cout << "test_find_comb(" << fullset << "," << subset << ") starting" << std::endl;
-	std::vector<uint32_t> fullset_vec(fullset);
-	std::vector<uint32_t> results1(subset);
-	std::vector<uint32_t> results2(subset);
+	uint32_t value;
+};
 
-	std::iota(fullset_vec.begin(), fullset_vec.end(), 0);
-	std::iota(results1.begin(), results1.end(), 0);
-	std::iota(results2.begin(), results2.end(), 0);
+template<typename int_type>
+bool test_threaded_comb_state(int_type thread_cnt, uint32_t fullset_size, uint32_t subset_size)
+{
+	std::cout << "test_threaded_comb_state(" << thread_cnt << ", " << fullset_size << ", " << subset_size << ") starting" << std::endl;
 
-	uint32_t nTotal = 0;
-	if (!concurrent_comb::compute_total_comb(fullset, subset, nTotal))
+	std::vector<no_equal_t> fullset(fullset_size);
+	for (uint32_t i = 0; i < fullset_size; ++i)
 	{
-		std::cerr << "compute_total_comb() returns false" << std::endl;
-		return;
+		fullset[i].value = i;
+	}
+
+	typedef std::vector<std::vector<no_equal_t>::const_iterator> state_type;
+	std::vector<std::vector< std::vector<uint32_t> > > vecvecvec((size_t)thread_cnt);
+
+	concurrent_comb::compute_all_comb_state(thread_cnt, subset_size, fullset,
+		[&vecvecvec](const int thread_index,
+			const size_t fullset_cnt,
+			const state_type& state) -> bool
+	{
+		std::vector<uint32_t> comb;
+		for (size_t i = 0; i < state.size(); ++i)
+		{
+			comb.push_back(state[i]->value);
+		}
+		vecvecvec[(size_t)thread_index].push_back(comb);
+		return true;
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<no_equal_t>& cont,
+			const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	std::vector<uint32_t> positions(fullset_size);
+	std::iota(positions.begin(), positions.end(), 0);
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector< std::vector<uint32_t> > vecvec;
+	do
+	{
+		vecvec.push_back(subset);
+	} while (stdcomb::next_combination(positions.begin(), positions.end(), subset.begin(), subset.end()));
+
+	std::vector< std::vector<uint32_t> > all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cout << "State combination count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	std::cout << "test_threaded_comb_state(" << thread_cnt << ", " << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// Steps next_combination_with_state through to its false return and checks
+// every state against next_combination. Build with -D_GLIBCXX_DEBUG to have
+// the debug iterators catch any step outside the sequences.
+bool test_next_comb_with_state(uint32_t fullset_size, uint32_t subset_size)
+{
+	std::cout << "test_next_comb_with_state(" << fullset_size << ", " << subset_size << ") starting" << std::endl;
+
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector<std::vector<uint32_t>::const_iterator> state;
+	for (uint32_t i = 0; i < subset_size; ++i)
+	{
+		state.push_back(fullset.cbegin() + i);
 	}
 
 	bool error = false;
-	for(uint32_t j=0; j<nTotal; ++j )
+	bool more_state = true;
+	bool more_subset = true;
+	while (more_state && more_subset && !error)
 	{
-		if(concurrent_comb::find_comb(fullset, subset, j, results1))
+		for (uint32_t i = 0; i < subset_size; ++i)
 		{
-			if(compare_vec(results1, results2)==false)
-			{
+			if (*state[i] != subset[i])
 				error = true;
-				std::cout << "Perm at " << j << " is not the same!" << std::endl;
-				display(results1);
-				display(results2);
-			}
-			else
-			{
-				//display(results1);
-			}
 		}
-		stdcomb::next_combination(fullset_vec.begin(), fullset_vec.end(), results2.begin(), results2.end());
+		more_state = stdcomb::next_combination_with_state(fullset.cbegin(), fullset.cend(), state.begin(), state.end());
+		more_subset = stdcomb::next_combination(fullset.begin(), fullset.end(), subset.begin(), subset.end());
 	}
-	std::cout << "test_find_comb(" << fullset << "," << subset << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	if (more_state != more_subset)
+	{
+		std::cout << "next_combination_with_state ended " << ((more_state) ? "after" : "before") << " next_combination" << std::endl;
+		error = true;
+	}
+	std::cout << "test_next_comb_with_state(" << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
 }
 
-void unit_test()
+template<typename int_type>
+bool test_threaded_comb_mask(int_type thread_cnt, uint32_t block_size, uint32_t fullset_size, uint32_t subset_size)
 {
-	test_find_comb(3,2);
-	test_find_comb(4,2);
-	test_find_comb(5,3);
-	test_find_comb(6,3);
+	std::cout << "test_threaded_comb_mask(" << thread_cnt << ", " << block_size << ", " << fullset_size << ", " << subset_size << ") starting" << std::endl;
+
+	std::vector<std::vector<uint64_t> > vecvecvec((size_t)thread_cnt);
+	auto err_callback = [](const int thread_index, const uint32_t fullset_cnt, const uint64_t mask, const std::string& error) -> void
+	{
+		std::cerr << error;
+	};
+
+	if (block_size == 0)
+	{
+		concurrent_comb::compute_all_comb_mask(thread_cnt, subset_size, fullset_size,
+			[&vecvecvec](const int thread_index, const uint32_t fullset_cnt, const uint64_t mask) -> bool
+		{
+			vecvecvec[(size_t)thread_index].push_back(mask);
+			return true;
+		}, err_callback);
+	}
+	else
+	{
+		concurrent_comb::compute_all_comb_mask_batched(thread_cnt, block_size, subset_size, fullset_size,
+			[&vecvecvec](const int thread_index, const uint32_t fullset_cnt, const uint64_t* masks, size_t mask_cnt, const int_type& block_start_index) -> bool
+		{
+			vecvecvec[(size_t)thread_index].insert(vecvecvec[(size_t)thread_index].end(), masks, masks + mask_cnt);
+			return true;
+		}, err_callback);
+	}
+
+	// every combination of bit positions, sorted as numbers
+	std::vector<uint32_t> positions(fullset_size);
+	std::iota(positions.begin(), positions.end(), 0);
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector<uint64_t> vecvec;
+	do
+	{
+		uint64_t mask = 0;
+		for (size_t i = 0; i < subset.size(); ++i)
+		{
+			mask |= uint64_t(1) << subset[i];
+		}
+		vecvec.push_back(mask);
+	} while (stdcomb::next_combination(positions.begin(), positions.end(), subset.begin(), subset.end()));
+	std::sort(vecvec.begin(), vecvec.end());
+
+	std::vector<uint64_t> all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cout << "Mask count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	for (size_t i = 0; i < vecvec.size() && !error; ++i)
+	{
+		uint64_t found = 0;
+		if (!concurrent_comb::find_comb_mask(fullset_size, subset_size, i, found) || found != vecvec[i])
+		{
+			error = true;
+			std::cout << "find_comb_mask(" << i << ") is wrong" << std::endl;
+		}
+	}
+	std::cout << "test_threaded_comb_mask(" << thread_cnt << ", " << block_size << ", " << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// Check that consecutive combinations differ by exactly the reported
+// out and in, and that the ranks follow the visiting order
+template<typename int_type>
+bool test_threaded_comb_revdoor(int_type thread_cnt, uint32_t fullset_size, uint32_t subset_size)
+{
+	std::cout << "test_threaded_comb_revdoor(" << thread_cnt << ", " << fullset_size << ", " << subset_size << ") starting" << std::endl;
+
+	typedef concurrent_permcomb::index_view<std::vector<uint32_t>, uint32_t> view_type;
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+	std::vector<std::vector<std::vector<uint32_t> > > vecvecvec((size_t)thread_cnt);
+	std::vector<char> errors((size_t)thread_cnt, 0);
+
+	concurrent_comb::compute_all_comb_revdoor(thread_cnt, subset_size, fullset,
+		[&vecvecvec, &errors](const int thread_index,
+			const size_t fullset_cnt,
+			const view_type& view,
+			uint32_t out,
+			uint32_t in) -> bool
+	{
+		std::vector<uint32_t> comb(view.indices(), view.indices() + view.size());
+		std::vector<std::vector<uint32_t> >& vecvec = vecvecvec[(size_t)thread_index];
+		if (vecvec.empty())
+		{
+			if (out != in)
+				errors[(size_t)thread_index] = 1;
+		}
+		else
+		{
+			// comb is the previous one with out swapped for in
+			std::vector<uint32_t> expected = vecvec.back();
+			std::vector<uint32_t>::iterator it = std::find(expected.begin(), expected.end(), out);
+			if (out == in || it == expected.end() || std::find(expected.begin(), expected.end(), in) != expected.end())
+				errors[(size_t)thread_index] = 1;
+			else
+			{
+				*it = in;
+				std::sort(expected.begin(), expected.end());
+				if (expected != comb)
+					errors[(size_t)thread_index] = 1;
+			}
+		}
+		vecvec.push_back(comb);
+		return true;
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont,
+			const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	bool error = std::find(errors.begin(), errors.end(), 1) != errors.end();
+	if (error)
+	{
+		std::cout << "Consecutive combinations do not differ by out and in" << std::endl;
+	}
+
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector< std::vector<uint32_t> > vecvec;
+	do
+	{
+		vecvec.push_back(subset);
+	} while (stdcomb::next_combination(fullset.begin(), fullset.end(), subset.begin(), subset.end()));
+
+	std::vector< std::vector<uint32_t> > all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
+	for (size_t i = 0; i < all_results.size() && !error; ++i)
+	{
+		int_type rank = 0;
+		std::vector<uint32_t> found;
+		if (!concurrent_comb::rank_comb_revdoor(fullset_size, all_results[i], rank) || rank != int_type(i) ||
+			!concurrent_comb::find_comb_revdoor(fullset_size, subset_size, int_type(i), found) || found != all_results[i])
+		{
+			error = true;
+			std::cout << "rank_comb_revdoor or find_comb_revdoor(" << i << ") is wrong" << std::endl;
+		}
+	}
+	std::sort(all_results.begin(), all_results.end());
+	if (all_results != vecvec)
+	{
+		error = true;
+		std::cout << "Revolving door combination count " << all_results.size() << " is not " << vecvec.size() << " or has repeats" << std::endl;
+	}
+	std::cout << "test_threaded_comb_revdoor(" << thread_cnt << ", " << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// Every shard of every cpu together must give each multiset exactly once,
+// in lexicographic order
+// C(60 + 30 - 1, 30) does not fit in int64_t, so the run must fail
+// through err_callback before any combination is visited
+bool test_multichoose_too_big()
+{
+	std::cout << "test_multichoose_too_big() starting" << std::endl;
+
+	std::vector<uint32_t> fullset(60);
+	std::iota(fullset.begin(), fullset.end(), 0);
+	int callback_cnt = 0;
+	int err_cnt = 0;
+	typedef concurrent_permcomb::index_view<std::vector<uint32_t>, uint32_t> view_type;
+	const bool ran = concurrent_comb::compute_all_multichoose(int64_t(4), 30, fullset,
+		[&callback_cnt](const int thread_index, const size_t fullset_cnt, const view_type& view) -> bool
+	{
+		++callback_cnt;
+		return true;
+	},
+		[&err_cnt](const int thread_index, const size_t fullset_cnt, const std::vector<uint32_t>& cont, const std::string& error) -> void
+	{
+		++err_cnt;
+	});
+
+	int64_t total = 0;
+	std::vector<uint32_t> found;
+	const bool error = ran || callback_cnt != 0 || err_cnt != 1 ||
+		concurrent_comb::compute_total_multichoose(60, 30, total) ||
+		concurrent_comb::find_multichoose(60, 30, int64_t(0), found);
+	std::cout << "test_multichoose_too_big() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_threaded_multichoose(int_type cpu_cnt, int_type thread_cnt, uint32_t fullset_size, uint32_t subset_size)
+{
+	std::cout << "test_threaded_multichoose(" << cpu_cnt << ", " << thread_cnt << ", " << fullset_size << ", " << subset_size << ") starting" << std::endl;
+
+	typedef concurrent_permcomb::index_view<std::string, uint32_t> view_type;
+	std::string fullset(fullset_size, 'A');
+	std::iota(fullset.begin(), fullset.end(), 'A');
+
+	std::vector<std::string> all_results;
+	for (int_type cpu_index = 0; cpu_index < cpu_cnt; ++cpu_index)
+	{
+		std::vector<std::vector<std::string> > vecvecvec((size_t)thread_cnt);
+		concurrent_comb::compute_all_multichoose_shard(cpu_index, cpu_cnt, thread_cnt, subset_size, fullset,
+			[&vecvecvec](const int thread_index,
+				const size_t fullset_cnt,
+				const view_type& view) -> bool
+		{
+			std::string comb;
+			for (size_t i = 0; i < view.size(); ++i)
+			{
+				comb.push_back(view[i]);
+			}
+			vecvecvec[(size_t)thread_index].push_back(comb);
+			return true;
+		},
+			[](const int thread_index,
+				const size_t fullset_cnt,
+				const std::string& cont,
+				const std::string& error) -> void
+		{
+			std::cerr << error;
+		});
+
+		for (size_t i = 0; i < vecvecvec.size(); ++i)
+		{
+			all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+		}
+	}
+
+	// every word of subset_size letters, keeping those with no letter
+	// smaller than the one before it
+	std::vector<std::string> vecvec;
+	std::vector<uint32_t> digits(subset_size, 0);
+	for (;;)
+	{
+		if (std::is_sorted(digits.begin(), digits.end()))
+		{
+			std::string comb;
+			for (size_t i = 0; i < digits.size(); ++i)
+			{
+				comb.push_back(fullset[digits[i]]);
+			}
+			vecvec.push_back(comb);
+		}
+		size_t i = digits.size();
+		while (i > 0 && digits[i - 1] == fullset_size - 1)
+		{
+			digits[--i] = 0;
+		}
+		if (i == 0)
+			break;
+		++digits[i - 1];
+	}
+
+	int_type total = 0;
+	concurrent_comb::compute_total_multichoose(fullset_size, subset_size, total);
+	bool error = (all_results != vecvec || total != static_cast<int_type>(vecvec.size()));
+	if (error)
+	{
+		std::cout << "Multiset count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	std::cout << "test_threaded_multichoose(" << cpu_cnt << ", " << thread_cnt << ", " << fullset_size << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// the 2^64 subsets of 64 elements do not fit in int64_t, so the run must
+// fail through err_callback before any subset is visited
+bool test_subsets_too_big()
+{
+	std::cout << "test_subsets_too_big() starting" << std::endl;
+
+	std::vector<uint32_t> fullset(64);
+	std::iota(fullset.begin(), fullset.end(), 0);
+	int callback_cnt = 0;
+	std::string err_msg;
+	typedef concurrent_permcomb::index_view<std::vector<uint32_t>, uint32_t> view_type;
+	const bool ran = concurrent_comb::compute_all_subsets(int64_t(4), 0, 64, concurrent_comb::subset_order::by_size, fullset,
+		[&callback_cnt](const int thread_index, const size_t fullset_cnt, const view_type& view) -> bool
+	{
+		++callback_cnt;
+		return true;
+	},
+		[&err_msg](const int thread_index, const size_t fullset_cnt, const std::vector<uint32_t>& cont, const std::string& error) -> void
+	{
+		err_msg += error;
+	});
+
+	int64_t total = 0;
+	const bool error = ran || callback_cnt != 0 || err_msg.find("does not fit") == std::string::npos ||
+		concurrent_comb::compute_total_subsets(63, 0, 63, total) ||
+		!concurrent_comb::compute_total_subsets(62, 0, 62, total) || total != (int64_t(1) << 62);
+	std::cout << "test_subsets_too_big() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_threaded_subsets(int_type cpu_cnt, int_type thread_cnt, uint32_t fullset_size, uint32_t min_size, uint32_t max_size, concurrent_comb::subset_order order)
+{
+	const bool by_size = (order == concurrent_comb::subset_order::by_size);
+	std::cout << "test_threaded_subsets(" << cpu_cnt << ", " << thread_cnt << ", " << fullset_size << ", " << min_size << ", " << max_size << 
+		", " << (by_size ? "by_size" : "binary_counter") << ") starting" << std::endl;
+
+	typedef concurrent_permcomb::index_view<std::vector<uint32_t>, uint32_t> view_type;
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+
+	std::vector<std::vector<uint32_t> > all_results;
+	for (int_type cpu_index = 0; cpu_index < cpu_cnt; ++cpu_index)
+	{
+		std::vector<std::vector<std::vector<uint32_t> > > vecvecvec((size_t)thread_cnt);
+		concurrent_comb::compute_all_subsets_shard(cpu_index, cpu_cnt, thread_cnt, min_size, max_size, order, fullset,
+			[&vecvecvec](const int thread_index,
+				const size_t fullset_cnt,
+				const view_type& view) -> bool
+		{
+			std::vector<uint32_t> subset;
+			for (size_t i = 0; i < view.size(); ++i)
+			{
+				subset.push_back(view[i]);
+			}
+			vecvecvec[(size_t)thread_index].push_back(subset);
+			return true;
+		},
+			[](const int thread_index,
+				const size_t fullset_cnt,
+				const std::vector<uint32_t>& cont,
+				const std::string& error) -> void
+		{
+			std::cerr << error;
+		});
+
+		for (size_t i = 0; i < vecvecvec.size(); ++i)
+		{
+			all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+		}
+	}
+
+	std::vector<std::vector<uint32_t> > vecvec;
+	if (by_size)
+	{
+		for (uint32_t size = min_size; size <= max_size; ++size)
+		{
+			std::vector<uint32_t> subset(size);
+			std::iota(subset.begin(), subset.end(), 0);
+			do
+			{
+				vecvec.push_back(subset);
+			} while (size > 0 && stdcomb::next_combination(fullset.begin(), fullset.end(), subset.begin(), subset.end()));
+		}
+	}
+	else
+	{
+		for (uint64_t mask = 0; mask < (uint64_t(1) << fullset_size); ++mask)
+		{
+			std::vector<uint32_t> subset;
+			for (uint32_t b = 0; b < fullset_size; ++b)
+			{
+				if (mask & (uint64_t(1) << b))
+					subset.push_back(b);
+			}
+			vecvec.push_back(subset);
+		}
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cout << "Subset count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	std::cout << "test_threaded_subsets(" << cpu_cnt << ", " << thread_cnt << ", " << fullset_size << ", " << min_size << ", " << max_size << 
+		", " << (by_size ? "by_size" : "binary_counter") << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// 100 distinct elements: the multiset total must fit int64_t exactly when
+// C(100, k) does, and a run which does not fit must fail through err_callback
+bool test_multiset_comb_too_big()
+{
+	std::cout << "test_multiset_comb_too_big() starting" << std::endl;
+
+	bool error = false;
+	const std::vector<uint32_t> group_counts(100, 1);
+	for (uint32_t k = 0; k <= 100; ++k)
+	{
+		int64_t total = 0;
+		int64_t expected = 0;
+		const bool fits = concurrent_comb::compute_total_multiset_comb(group_counts, k, total);
+		if (fits != concurrent_comb::compute_total_comb(100, k, expected) || (fits && total != expected))
+		{
+			error = true;
+			std::cerr << "compute_total_multiset_comb(100, " << k << ") is wrong" << std::endl;
+		}
+	}
+
+	std::vector<uint32_t> fullset(100);
+	std::iota(fullset.begin(), fullset.end(), 0);
+	int callback_cnt = 0;
+	int err_cnt = 0;
+	for (uint32_t subset = 50; subset <= 99; subset += 49)
+	{
+		concurrent_comb::compute_all_multiset_comb(int64_t(4), subset, fullset,
+			[&callback_cnt](const int thread_index, const size_t fullset_cnt, const std::vector<uint32_t>& cont) -> bool
+		{
+			++callback_cnt;
+			return true;
+		},
+			[&err_cnt](const int thread_index, const size_t fullset_cnt, const std::vector<uint32_t>& cont, const std::string& error) -> void
+		{
+			++err_cnt;
+		});
+	}
+	// only the 100 combinations of 99 elements are visited
+	error = error || callback_cnt != 100 || err_cnt != 1;
+	std::cout << "test_multiset_comb_too_big() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+// Each distinct combination of a multiset exactly once, in lexicographic
+// order by pred
+template<typename int_type, typename predicate_type>
+bool test_threaded_multiset_comb(int_type cpu_cnt, int_type thread_cnt, const std::string& fullset, uint32_t subset_size, predicate_type pred)
+{
+	std::cout << "test_threaded_multiset_comb(" << cpu_cnt << ", " << thread_cnt << ", " << fullset << ", " << subset_size << ") starting" << std::endl;
+
+	std::vector<std::string> all_results;
+	for (int_type cpu_index = 0; cpu_index < cpu_cnt; ++cpu_index)
+	{
+		std::vector<std::vector<std::string> > vecvecvec((size_t)thread_cnt);
+		concurrent_comb::compute_all_multiset_comb_shard(cpu_index, cpu_cnt, thread_cnt, subset_size, fullset,
+			[&vecvecvec](const int thread_index,
+				const size_t fullset_cnt,
+				const std::string& cont) -> bool
+		{
+			vecvecvec[(size_t)thread_index].push_back(cont);
+			return true;
+		},
+			[](const int thread_index,
+				const size_t fullset_cnt,
+				const std::string& cont,
+				const std::string& error) -> void
+		{
+			std::cerr << error;
+		}, pred);
+
+		for (size_t i = 0; i < vecvecvec.size(); ++i)
+		{
+			all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+		}
+	}
+
+	// every subset of positions of the sorted fullset, without repeats
+	std::string sorted = fullset;
+	std::sort(sorted.begin(), sorted.end(), pred);
+	auto less = [pred](const std::string& a, const std::string& b)
+	{
+		return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), pred);
+	};
+	std::vector<std::string> vecvec;
+	for (uint32_t mask = 0; mask < (1u << sorted.size()); ++mask)
+	{
+		if (concurrent_permcomb::popcount64(mask) != subset_size)
+			continue;
+		std::string comb;
+		for (uint32_t b = 0; b < sorted.size(); ++b)
+		{
+			if (mask & (1u << b))
+				comb.push_back(sorted[b]);
+		}
+		vecvec.push_back(comb);
+	}
+	std::sort(vecvec.begin(), vecvec.end(), less);
+	vecvec.erase(std::unique(vecvec.begin(), vecvec.end()), vecvec.end());
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cout << "Multiset combination count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	std::cout << "test_threaded_multiset_comb(" << cpu_cnt << ", " << thread_cnt << ", " << fullset << ", " << subset_size <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// Keep the combinations of element values whose sum is within budget,
+// pruning a prefix as soon as its sum is over
+template<typename int_type>
+bool test_threaded_comb_pruned(int_type thread_cnt, uint32_t fullset_size, uint32_t subset_size, uint32_t budget)
+{
+	std::cout << "test_threaded_comb_pruned(" << thread_cnt << ", " << fullset_size << ", " << subset_size << ", " << budget << ") starting" << std::endl;
+
+	typedef concurrent_permcomb::index_view<std::vector<uint32_t>, uint32_t> view_type;
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+
+	std::vector<std::vector<std::vector<uint32_t> > > vecvecvec((size_t)thread_cnt);
+	std::vector<std::vector<uint32_t> > prev_combs((size_t)thread_cnt);
+	std::vector<int_type> call_cnts((size_t)thread_cnt, 0);
+	std::vector<char> pos_errors((size_t)thread_cnt, 0);
+
+	concurrent_comb::compute_all_comb_pruned(thread_cnt, subset_size, fullset,
+		[&](const int thread_index, const size_t fullset_cnt, const view_type& view, uint32_t changed_pos, uint32_t& prune_len) -> bool
+	{
+		++call_cnts[thread_index];
+		std::vector<uint32_t> comb(view.indices(), view.indices() + view.size());
+		std::vector<uint32_t>& prev = prev_combs[thread_index];
+		if (!prev.empty() && (!std::equal(prev.begin(), prev.begin() + changed_pos, comb.begin()) || prev[changed_pos] == comb[changed_pos]))
+			pos_errors[thread_index] = 1;
+		prev = comb;
+
+		uint32_t sum = 0;
+		for (uint32_t p = 0; p < view.size(); ++p)
+		{
+			sum += view[p];
+			if (sum > budget)
+			{
+				prune_len = p + 1;
+				return true;
+			}
+		}
+		vecvecvec[thread_index].push_back(comb);
+		return true;
+	},
+		[](const int thread_index, const size_t fullset_cnt, const std::vector<uint32_t>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	std::vector<uint32_t> subset(subset_size);
+	std::iota(subset.begin(), subset.end(), 0);
+	std::vector<std::vector<uint32_t> > vecvec;
+	int_type total = 0;
+	do
+	{
+		++total;
+		if (std::accumulate(subset.begin(), subset.end(), 0u) <= budget)
+			vecvec.push_back(subset);
+	} while (stdcomb::next_combination(fullset.begin(), fullset.end(), subset.begin(), subset.end()));
+
+	std::vector<std::vector<uint32_t> > all_results;
+	int_type call_cnt = 0;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+		call_cnt += call_cnts[i];
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cerr << "Pruned results count " << all_results.size() << " is not " << vecvec.size() << std::endl;
+	}
+	if (std::count(pos_errors.begin(), pos_errors.end(), 1) > 0)
+	{
+		error = true;
+		std::cerr << "changed_pos is wrong" << std::endl;
+	}
+	std::cout << "test_threaded_comb_pruned(" << thread_cnt << ", " << fullset_size << ", " << subset_size << ", " << budget << ") visited " << call_cnt << " of " << total <<
+		" and finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// Check compute_total_comb against Pascal's triangle in uint64_t. Every
+// C(n, k) must come out right whenever it fits in T, and be refused when not.
+template<typename T>
+bool test_compute_total_comb(uint32_t max_fullset)
+{
+	const uint64_t saturated = std::numeric_limits<uint64_t>::max();
+	std::vector<uint64_t> row(1, 1);
+	bool error = false;
+	for (uint32_t n = 0; n <= max_fullset; ++n)
+	{
+		for (uint32_t k = 0; k <= n; ++k)
+		{
+			const bool fits = row[k] != saturated && row[k] <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+			T total = 0;
+			const bool ok = concurrent_comb::compute_total_comb(n, k, total);
+			if (ok != fits || (ok && static_cast<uint64_t>(total) != row[k]))
+			{
+				std::cerr << "compute_total_comb(" << n << ", " << k << ") is wrong" << std::endl;
+				error = true;
+			}
+		}
+		std::vector<uint64_t> next(n + 2, 1);
+		for (uint32_t k = 1; k <= n; ++k)
+		{
+			const uint64_t sum = row[k - 1] + row[k];
+			next[k] = (row[k - 1] == saturated || row[k] == saturated || sum < row[k]) ? saturated : sum;
+		}
+		row.swap(next);
+	}
+	T total = 0;
+	if (concurrent_comb::compute_total_comb(3, 4, total))
+		error = true;
+	std::cout << "test_compute_total_comb(" << max_fullset << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_threaded_comb_cancel(int_type thread_cnt, uint32_t fullset_size, uint32_t subset_size, int_type target_index)
+{
+	std::cout << "test_threaded_comb_cancel(" << thread_cnt << ", " << fullset_size << ", " << subset_size << ", " << target_index << ") starting" << std::endl;
+
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+
+	int_type total = 0;
+	concurrent_comb::compute_total_comb(fullset_size, subset_size, total);
+	const std::vector<uint32_t> target = concurrent_comb::find_comb_by_idx(subset_size, target_index, fullset);
+
+	std::vector<int_type> visited((size_t)thread_cnt, 0);
+	concurrent_permcomb::cancel_token token;
+
+	concurrent_permcomb::run_status status = concurrent_comb::compute_all_comb(token, thread_cnt, subset_size, fullset,
+		[&visited, &target](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont) -> bool
+	{
+		++visited[(size_t)thread_index];
+		return cont != target; // false trips the token
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont,
+			const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	int_type visited_cnt = 0;
+	for (size_t i = 0; i < visited.size(); ++i)
+	{
+		visited_cnt += visited[i];
+	}
+
+	bool error = false;
+	if (status != concurrent_permcomb::run_status::cancelled)
+	{
+		error = true;
+		std::cout << "Run was not reported as cancelled" << std::endl;
+	}
+	// a thread may run up to cancel_check_interval results past the hit
+	if (visited_cnt >= total / 2)
+	{
+		error = true;
+		std::cout << "Visited " << visited_cnt << " of " << total << " after cancel" << std::endl;
+	}
+
+	// subset larger than fullset goes through err_callback
+	token.reset();
+	status = concurrent_comb::compute_all_comb(token, thread_cnt, fullset_size + 1, fullset,
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont) -> bool
+	{
+		return true;
+	},
+		[](const int thread_index,
+			const size_t fullset_cnt,
+			const std::vector<uint32_t>& cont,
+			const std::string& error) -> void
+	{
+	});
+	if (status != concurrent_permcomb::run_status::failed)
+	{
+		error = true;
+		std::cout << "Run was not reported as failed" << std::endl;
+	}
+	std::cout << "test_threaded_comb_cancel(" << thread_cnt << ", " << fullset_size << ", " << subset_size << ", " << target_index <<
+		") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// return false to stop processing
+template<typename container_type>
+struct empty_callback_t
+{
+	bool operator()(const int thread_index, const size_t fullset_size, const container_type& cont)
+	{
+		return true;
+	}
+};
+
+template<typename container_type>
+struct empty_view_callback_t
+{
+	bool operator()(const int thread_index, const size_t fullset_size, const concurrent_permcomb::index_view<container_type, uint32_t>& view)
+	{
+		return true;
+	}
+};
+
+template<typename container_type>
+struct error_callback_t
+{
+	void operator()(const int thread_index, const size_t fullset_size, const container_type& cont, const std::string& error)
+	{
+		std::cerr << error << std::endl;
+	}
+};
+
+//typedef boost::multiprecision::cpp_int int_type;
+//typedef boost::multiprecision::int128_t int_type;
+//typedef unsigned __int128 int_type; // GCC and Clang, up to C(130, 65)
+typedef int64_t int_type;
+
+int main(int argc, char* argv[])
+{
+	//benchmark_comb();
+
+	//benchmark_comb_idx();
+
+	//unit_test();
+
+	//unit_test_threaded();
+
+	//unit_test_threaded_predicate();
+
+	//unit_test_threaded_shard();
+
+	//unit_test_threaded_chunked();
+
+	//unit_test_threaded_pool();
+
+	//unit_test_threaded_batched();
+
+	//unit_test_threaded_cancel();
+
+	//unit_test_threaded_idx();
+
+	//unit_test_threaded_state();
+
+	//unit_test_next_comb_with_state();
+
+	//unit_test_threaded_mask();
+
+	//unit_test_threaded_revdoor();
+
+	//unit_test_threaded_multichoose();
+
+	//unit_test_threaded_subsets();
+
+	//unit_test_threaded_multiset();
+
+	//unit_test_threaded_pruned();
+
+	//unit_test_comb_by_idx();
+
+	//unit_test_rank_comb();
+
+	//unit_test_total_comb();
+
+	//unit_test_comb_past_int64();
+
+	//usage_of_next_comb();
+
+	//usage_of_next_comb_with_state();
+
+	//usage_of_comb_by_idx();
+
+	usage_of_comb_state_by_idx();
+
+	return 0;
+}
+
+void benchmark_comb()
+{
+	std::vector<int> fullset_vec(20);
+	std::iota(fullset_vec.begin(), fullset_vec.end(), 0);
+	uint32_t subset = 10;
+
+	timer stopwatch;
+	{
+		std::vector<int> fullset_vec2(fullset_vec.begin(), fullset_vec.end());
+		std::vector<int> subset_vec(fullset_vec.begin(), fullset_vec.begin()+ subset);
+
+		stopwatch.start("next_combination");
+		while (stdcomb::next_combination(fullset_vec2.begin(), fullset_vec2.end(), subset_vec.begin(), subset_vec.end()))
+		{
+
+		}
+		stopwatch.stop();
+	}
+
+
+	int_type thread_cnt = 1;
+
+	typedef empty_callback_t<decltype(fullset_vec)> callback_t;
+	typedef error_callback_t<decltype(fullset_vec)> err_callback_t;
+
+	stopwatch.start("1 thread(s)");
+	thread_cnt = 1;
+	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
+	stopwatch.stop();
+
+	stopwatch.start("2 thread(s)");
+	thread_cnt = 2;
+	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
+	stopwatch.stop();
+
+	stopwatch.start("3 thread(s)");
+	thread_cnt = 3;
+	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
+	stopwatch.stop();
+
+	stopwatch.start("4 thread(s)");
+	thread_cnt = 4;
+	concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
+	stopwatch.stop();
+}
+
+void benchmark_comb_idx()
+{
+	std::vector<int> fullset_vec(28);
+	std::iota(fullset_vec.begin(), fullset_vec.end(), 0);
+	uint32_t subset = 14;
+
+	typedef empty_callback_t<decltype(fullset_vec)> callback_t;
+	typedef empty_view_callback_t<decltype(fullset_vec)> view_callback_t;
+	typedef error_callback_t<decltype(fullset_vec)> err_callback_t;
+
+	timer stopwatch;
+	for (int_type thread_cnt = 1; thread_cnt <= 4; ++thread_cnt)
+	{
+		std::ostringstream oss;
+		oss << "comb " << thread_cnt << " thread(s)";
+		stopwatch.start(oss.str());
+		concurrent_comb::compute_all_comb(thread_cnt, subset, fullset_vec, callback_t(), err_callback_t());
+		stopwatch.stop();
+
+		oss.str("");
+		oss << "comb_idx " << thread_cnt << " thread(s)";
+		stopwatch.start(oss.str());
+		concurrent_comb::compute_all_comb_idx(thread_cnt, subset, fullset_vec, view_callback_t(), err_callback_t());
+		stopwatch.stop();
+	}
+}
+
+void test_find_comb(uint32_t fullset, uint32_t subset)
+{
+	std::cout << "test_find_comb(" << fullset << "," << subset << ") starting" << std::endl;
+	std::vector<uint32_t> fullset_vec(fullset);
+	std::vector<uint32_t> results1(subset);
+	std::vector<uint32_t> results2(subset);
+
+	std::iota(fullset_vec.begin(), fullset_vec.end(), 0);
+	std::iota(results1.begin(), results1.end(), 0);
+	std::iota(results2.begin(), results2.end(), 0);
+
+	uint32_t nTotal = 0;
+	if (!concurrent_comb::compute_total_comb(fullset, subset, nTotal))
+	{
+		std::cerr << "compute_total_comb() returns false" << std::endl;
+		return;
+	}
+
+	const concurrent_comb::binomial_table<uint32_t> table(fullset, subset);
+	std::vector<uint32_t> results3;
+
+	bool error = false;
+	for(uint32_t j=0; j<nTotal; ++j )
+	{
+		if(concurrent_comb::find_comb(fullset, subset, j, results1) && concurrent_comb::find_comb(table, j, results3))
+		{
+			if(compare_vec(results1, results2)==false || compare_vec(results3, results2)==false)
+			{
+				error = true;
+				std::cout << "Perm at " << j << " is not the same!" << std::endl;
+				display(results1);
+				display(results2);
+			}
+			else
+			{
+				//display(results1);
+			}
+		}
+		stdcomb::next_combination(fullset_vec.begin(), fullset_vec.end(), results2.begin(), results2.end());
+	}
+	std::cout << "test_find_comb(" << fullset << "," << subset << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+}
+
+void unit_test()
+{
+	test_find_comb(3,2);
+	test_find_comb(4,2);
+	test_find_comb(5,3);
+	test_find_comb(6,3);
 	test_find_comb(7,4);
 	test_find_comb(8,4);
 	test_find_comb(9,5);
@@ -445,6 +1579,414 @@ void unit_test_threaded_shard()
 	//test_threaded_comb_shard(thread_cnt, 2, 1); // should fail
 }
 
+void unit_test_threaded_chunked()
+{
+	int_type thread_cnt = 4;
+	test_threaded_comb_chunked(thread_cnt, int_type(1), 5, 3);
+	test_threaded_comb_chunked(thread_cnt, int_type(7), 8, 4);
+	test_threaded_comb_chunked(thread_cnt, int_type(64), 10, 5);
+	test_threaded_comb_chunked(thread_cnt, int_type(1000), 12, 6);
+	test_threaded_comb_chunked(thread_cnt, int_type(100000), 6, 3); // more chunks than combinations
+}
+
+void unit_test_threaded_pool()
+{
+	int_type thread_cnt = 4;
+	concurrent_permcomb::thread_pool pool(static_cast<int>(thread_cnt));
+	// the same parked threads serve every call
+	test_threaded_comb_pool(pool, thread_cnt, 5, 3);
+	test_threaded_comb_pool(pool, thread_cnt, 8, 4);
+	test_threaded_comb_pool(pool, int_type(2), 10, 5);
+	test_threaded_comb_pool(pool, thread_cnt, 2, 1);
+	for (int i = 0; i < 100; ++i)
+	{
+		if (!test_threaded_comb_pool(pool, thread_cnt, 6, 3))
+			break;
+	}
+}
+
+void unit_test_threaded_batched()
+{
+	int_type thread_cnt = 4;
+	test_threaded_comb_batched(thread_cnt, 1, 5, 3);
+	test_threaded_comb_batched(thread_cnt, 7, 8, 4);
+	test_threaded_comb_batched(thread_cnt, 64, 10, 5);
+	test_threaded_comb_batched(thread_cnt, 1000, 12, 6); // block larger than a thread's slice
+	test_threaded_comb_batched(int_type(1), 16, 6, 3);
+}
+
+void unit_test_threaded_cancel()
+{
+	int_type thread_cnt = 4;
+	test_threaded_comb_cancel(thread_cnt, 24, 12, int_type(0)); // first combination
+	test_threaded_comb_cancel(thread_cnt, 24, 12, int_type(1000)); // early in the first slice
+	test_threaded_comb_cancel(thread_cnt, 24, 12, int_type(2100000)); // early in the last slice
+}
+
+void unit_test_threaded_idx()
+{
+	int_type thread_cnt = 4;
+	std::vector<uint32_t> fullset(12);
+	std::iota(fullset.begin(), fullset.end(), 0);
+	test_threaded_comb_idx(thread_cnt, fullset, 6);
+	test_threaded_comb_idx(thread_cnt, fullset, 1);
+	test_threaded_comb_idx(thread_cnt, fullset, 12);
+	test_threaded_comb_idx(int_type(1), fullset, 3);
+
+	// duplicates are combined by position
+	std::vector<uint32_t> dups = { 1, 1, 2, 2, 2, 3, 5, 5 };
+	test_threaded_comb_idx(thread_cnt, dups, 4);
+}
+
+void unit_test_threaded_state()
+{
+	int_type thread_cnt = 4;
+	test_threaded_comb_state(thread_cnt, 5, 3);
+	test_threaded_comb_state(thread_cnt, 8, 4);
+	test_threaded_comb_state(thread_cnt, 10, 1);
+	test_threaded_comb_state(thread_cnt, 12, 6);
+	test_threaded_comb_state(thread_cnt, 6, 6);
+	test_threaded_comb_state(int_type(1), 7, 3);
+}
+
+void unit_test_next_comb_with_state()
+{
+	test_next_comb_with_state(6, 6);
+	test_next_comb_with_state(6, 1);
+	test_next_comb_with_state(1, 1);
+	test_next_comb_with_state(7, 3);
+}
+
+void unit_test_threaded_mask()
+{
+	int_type thread_cnt = 4;
+	test_threaded_comb_mask(thread_cnt, 0, 5, 3);
+	test_threaded_comb_mask(thread_cnt, 0, 12, 6);
+	test_threaded_comb_mask(thread_cnt, 0, 16, 1);
+	test_threaded_comb_mask(thread_cnt, 0, 16, 16);
+	test_threaded_comb_mask(thread_cnt, 7, 12, 5);
+	test_threaded_comb_mask(thread_cnt, 1000, 14, 7);
+	test_threaded_comb_mask(thread_cnt, 0, 64, 63); // top bit in use
+	test_threaded_comb_mask(thread_cnt, 16, 64, 64);
+}
+
+void unit_test_threaded_revdoor()
+{
+	int_type thread_cnt = 4;
+	test_threaded_comb_revdoor(thread_cnt, 5, 3);
+	test_threaded_comb_revdoor(thread_cnt, 8, 4);
+	test_threaded_comb_revdoor(thread_cnt, 9, 4);
+	test_threaded_comb_revdoor(thread_cnt, 10, 1);
+	test_threaded_comb_revdoor(thread_cnt, 10, 2);
+	test_threaded_comb_revdoor(thread_cnt, 12, 7);
+	test_threaded_comb_revdoor(thread_cnt, 6, 6);
+	test_threaded_comb_revdoor(int_type(1), 7, 3);
+}
+
+void unit_test_threaded_multichoose()
+{
+	int_type thread_cnt = 4;
+	test_threaded_multichoose(int_type(1), thread_cnt, 5, 3);
+	test_threaded_multichoose(int_type(1), thread_cnt, 3, 7); // subset larger than fullset
+	test_threaded_multichoose(int_type(1), thread_cnt, 8, 1);
+	test_threaded_multichoose(int_type(1), thread_cnt, 1, 4);
+	test_threaded_multichoose(int_type(3), thread_cnt, 6, 6);
+	test_threaded_multichoose(int_type(2), int_type(1), 7, 4);
+	test_multichoose_too_big();
+}
+
+void unit_test_threaded_subsets()
+{
+	const concurrent_comb::subset_order by_size = concurrent_comb::subset_order::by_size;
+	const concurrent_comb::subset_order binary_counter = concurrent_comb::subset_order::binary_counter;
+	int_type thread_cnt = 4;
+	test_threaded_subsets(int_type(1), thread_cnt, 10, 0, 10, by_size);
+	test_threaded_subsets(int_type(1), thread_cnt, 10, 3, 6, by_size);
+	test_threaded_subsets(int_type(3), thread_cnt, 12, 1, 12, by_size);
+	test_threaded_subsets(int_type(1), thread_cnt, 7, 7, 7, by_size);
+	test_threaded_subsets(int_type(1), thread_cnt, 10, 0, 10, binary_counter);
+	test_threaded_subsets(int_type(3), thread_cnt, 13, 0, 13, binary_counter);
+	test_threaded_subsets(int_type(1), int_type(1), 1, 0, 1, binary_counter);
+	test_subsets_too_big();
+}
+
+void unit_test_threaded_multiset()
+{
+	int_type thread_cnt = 4;
+	std::less<char> less;
+	test_threaded_multiset_comb(int_type(1), thread_cnt, "AABBBCDDDD", 4, less);
+	test_threaded_multiset_comb(int_type(1), thread_cnt, "DBADBCADDB", 1, less);
+	test_threaded_multiset_comb(int_type(1), thread_cnt, "AABBBCDDDD", 10, less);
+	test_threaded_multiset_comb(int_type(3), thread_cnt, "AAAABBBBCCCCDDD", 7, less);
+	test_threaded_multiset_comb(int_type(1), thread_cnt, "ABCDEFGHIJ", 5, less); // no duplicates
+	test_threaded_multiset_comb(int_type(1), int_type(1), "AAAAAA", 3, less);
+	test_threaded_multiset_comb(int_type(2), thread_cnt, "AABBBCDDDD", 6, std::greater<char>());
+
+	std::string original_text = "ABBCCC";
+	std::string expected[] = { "ABB", "ABC", "ACC", "BBC", "BCC", "CCC" };
+	for (int i = 0; i < 6; ++i)
+	{
+		if (concurrent_comb::find_multiset_comb_by_idx(3, int_type(i), original_text) != expected[i])
+			std::cout << "find_multiset_comb_by_idx(" << i << ") is wrong" << std::endl;
+	}
+	test_multiset_comb_too_big();
+}
+
+void unit_test_threaded_pruned()
+{
+	int_type thread_cnt = 4;
+	test_threaded_comb_pruned(thread_cnt, 10, 4, 12);
+	test_threaded_comb_pruned(thread_cnt, 20, 6, 30);
+	test_threaded_comb_pruned(thread_cnt, 20, 6, 1000); // nothing pruned
+	test_threaded_comb_pruned(thread_cnt, 24, 8, 40);
+	test_threaded_comb_pruned(thread_cnt, 12, 1, 5);
+	test_threaded_comb_pruned(int_type(1), 16, 5, 20);
+}
+
+// rank_comb must undo find_comb for every index
+template<typename int_type>
+bool test_rank_comb(uint32_t fullset, uint32_t subset)
+{
+	std::cout << "test_rank_comb(" << fullset << "," << subset << ") starting" << std::endl;
+	const concurrent_comb::binomial_table<int_type> table(fullset, subset);
+	std::vector<uint32_t> fullset_vec(fullset);
+	std::iota(fullset_vec.begin(), fullset_vec.end(), 0);
+	std::vector<uint32_t> comb(subset);
+	std::iota(comb.begin(), comb.end(), 0);
+
+	bool error = false;
+	int_type j = 0;
+	do
+	{
+		int_type rank = 0;
+		if (!concurrent_comb::rank_comb(table, comb, rank) || rank != j)
+		{
+			error = true;
+			std::cerr << "rank_comb at " << j << " is " << rank << std::endl;
+			break;
+		}
+		++j;
+	} while (stdcomb::next_combination(fullset_vec.begin(), fullset_vec.end(), comb.begin(), comb.end()));
+
+	int_type rank = 0;
+	std::vector<uint32_t> bad(subset, 0);
+	if (subset > 1 && concurrent_comb::rank_comb(table, bad, rank))
+	{
+		error = true;
+		std::cerr << "rank_comb accepted repeats" << std::endl;
+	}
+	std::cout << "test_rank_comb(" << fullset << "," << subset << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_rank_comb_bulk(int_type thread_cnt)
+{
+	std::cout << "test_rank_comb_bulk(" << thread_cnt << ") starting" << std::endl;
+	std::string original = "ABCDEFGHIJ";
+	std::string comb = "ABCD";
+	std::vector<std::string> combs;
+	do
+	{
+		combs.push_back(comb);
+	} while (stdcomb::next_combination(original.begin(), original.end(), comb.begin(), comb.end()));
+	std::reverse(combs.begin(), combs.end());
+	combs.push_back("ABDC"); // out of order
+	combs.push_back("ABCZ");
+
+	std::vector<int_type> ranks;
+	bool error = concurrent_comb::rank_comb_bulk(thread_cnt, 4, original, combs, ranks);
+	const int_type total = static_cast<int_type>(combs.size() - 2);
+	for (size_t i = 0; i < combs.size() - 2; ++i)
+	{
+		if (ranks[i] != total - 1 - static_cast<int_type>(i))
+			error = true;
+	}
+	if (ranks[combs.size() - 2] != total || ranks[combs.size() - 1] != total)
+		error = true;
+	std::cout << "test_rank_comb_bulk(" << thread_cnt << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+// The second half of C(fullset, subset) and of the 2^fullset subsets starts
+// past int64_t, so these runs count on uint64_t sub-ranges
+template<typename int_type>
+bool test_threaded_comb_past_int64(uint32_t fullset_size, uint32_t subset_size)
+{
+	std::cout << "test_threaded_comb_past_int64(" << fullset_size << ", " << subset_size << ") starting" << std::endl;
+
+	typedef concurrent_permcomb::index_view<std::vector<uint32_t>, uint32_t> view_type;
+	std::vector<uint32_t> fullset(fullset_size);
+	std::iota(fullset.begin(), fullset.end(), 0);
+	const concurrent_comb::binomial_table<int_type> table(fullset_size, subset_size);
+	const int_type cpu_cnt = 2;
+	const int_type start_index = table.total() / cpu_cnt;
+	auto err_callback = [](const int thread_index, const size_t fullset_cnt, const std::vector<uint32_t>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	};
+
+	// block ranks are absolute although the loop counts from its sub-range
+	std::vector<int_type> block_starts;
+	std::vector<uint32_t> block_combs;
+	concurrent_comb::compute_all_comb_batched_shard(int_type(1), cpu_cnt, int_type(1), 7, subset_size, fullset,
+		[&block_starts, &block_combs](const int thread_index,
+			const size_t fullset_cnt,
+			const uint32_t* block,
+			size_t block_cnt,
+			uint32_t subset_cnt,
+			const int_type& block_start_index) -> bool
+	{
+		block_starts.push_back(block_start_index);
+		block_combs.insert(block_combs.end(), block, block + block_cnt * subset_cnt);
+		return block_starts.size() < 3;
+	}, err_callback);
+	bool error = (block_starts.size() != 3);
+	for (uint32_t i = 0; i < block_starts.size(); ++i)
+	{
+		const std::vector<uint32_t> comb(block_combs.begin() + i * 7 * subset_size, block_combs.begin() + (i * 7 + 1) * subset_size);
+		if (block_starts[i] != start_index + int_type(i * 7) || comb != concurrent_comb::find_comb_by_idx(table, block_starts[i], fullset))
+		{
+			std::cerr << "Wrong block at index " << block_starts[i] << std::endl;
+			error = true;
+			break;
+		}
+	}
+
+	// pruning by the first element jumps over every combination sharing it,
+	// across many uint64_t sub-ranges, until the end of the slice
+	std::vector<std::vector<uint32_t> > pruned;
+	concurrent_comb::compute_all_comb_pruned_shard(int_type(1), cpu_cnt, int_type(1), subset_size, fullset,
+		[&pruned](const int thread_index, const size_t fullset_cnt, const view_type& view, uint32_t changed_pos, uint32_t& prune_len) -> bool
+	{
+		pruned.push_back(std::vector<uint32_t>(view.indices(), view.indices() + view.size()));
+		prune_len = 1;
+		return true;
+	}, err_callback);
+	std::vector<uint32_t> first;
+	concurrent_comb::find_comb(table, start_index, first);
+	if (pruned.empty() || pruned[0] != first || pruned.size() != fullset_size - subset_size + 1 - first[0])
+	{
+		std::cerr << "Pruned combination count " << pruned.size() << " is wrong" << std::endl;
+		error = true;
+	}
+	for (uint32_t i = 1; i < pruned.size() && !error; ++i)
+	{
+		std::vector<uint32_t> block_first(subset_size);
+		std::iota(block_first.begin(), block_first.end(), first[0] + i);
+		if (pruned[i] != block_first)
+		{
+			std::cerr << "Wrong pruned combination " << i << std::endl;
+			error = true;
+		}
+	}
+
+	// the second half of the power set is the first half plus the last element
+	std::vector<std::vector<uint32_t> > subsets;
+	concurrent_comb::compute_all_subsets_shard(int_type(1), cpu_cnt, int_type(1), 0, fullset_size, concurrent_comb::subset_order::binary_counter, fullset,
+		[&subsets](const int thread_index, const size_t fullset_cnt, const view_type& view) -> bool
+	{
+		subsets.push_back(std::vector<uint32_t>(view.indices(), view.indices() + view.size()));
+		return subsets.size() < 8;
+	}, err_callback);
+	error = error || (subsets.size() != 8);
+	for (uint32_t i = 0; i < subsets.size() && !error; ++i)
+	{
+		std::vector<uint32_t> expected;
+		for (uint32_t b = 0; b < 3; ++b)
+		{
+			if (i & (1 << b))
+				expected.push_back(b);
+		}
+		expected.push_back(fullset_size - 1);
+		if (subsets[i] != expected)
+		{
+			std::cerr << "Wrong subset " << i << std::endl;
+			error = true;
+		}
+	}
+	std::cout << "test_threaded_comb_past_int64(" << fullset_size << ", " << subset_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+void unit_test_rank_comb()
+{
+	test_rank_comb<int_type>(1, 1);
+	test_rank_comb<int_type>(5, 3);
+	test_rank_comb<int_type>(8, 1);
+	test_rank_comb<int_type>(8, 8);
+	test_rank_comb<int_type>(12, 6);
+	test_rank_comb<int_type>(16, 5);
+	test_rank_comb<int_type>(18, 13);
+	test_rank_comb_bulk(int_type(4));
+	test_rank_comb_bulk(int_type(1));
+}
+
+void unit_test_total_comb()
+{
+	test_compute_total_comb<int32_t>(40);
+	test_compute_total_comb<uint32_t>(40);
+	test_compute_total_comb<int64_t>(70);
+	test_compute_total_comb<uint64_t>(70);
+
+	// C(40, 20) fits in int64_t although 40! / 20! does not
+	int64_t total = 0;
+	bool error = !concurrent_comb::compute_total_comb(40, 20, total) || total != 137846528820LL;
+
+	// 10 of 12 runs on int32_t, 40 of 80 on __int128 where there is one, 70 of 140 does not fit any
+	std::string text = "ABCDEFGHIJKL";
+	std::atomic<int64_t> cnt(0);
+	std::atomic<int> err_cnt(0);
+	auto callback = [&cnt](const int thread_index, const size_t fullset_cnt, const std::string& cont) -> bool
+	{
+		++cnt;
+		return true;
+	};
+	auto err_callback = [&err_cnt](const int thread_index, const size_t fullset_cnt, const std::string& cont, const std::string& error) -> void
+	{
+		++err_cnt;
+	};
+	if (!concurrent_comb::compute_all_comb_native(4, 10, text, callback, err_callback) || cnt != 66)
+		error = true;
+#if defined(__SIZEOF_INT128__)
+	// every thread stops at its first combination
+	std::string wide(80, 'A');
+	cnt = 0;
+	auto first_callback = [&cnt](const int thread_index, const size_t fullset_cnt, const std::string& cont) -> bool
+	{
+		++cnt;
+		return false;
+	};
+	if (!concurrent_comb::compute_all_comb_native(int64_t(4), 40, wide, first_callback, err_callback) || cnt != 4 || err_cnt != 0)
+		error = true;
+#endif
+	std::string big(140, 'A');
+	if (concurrent_comb::compute_all_comb_native(4, 70, big, callback, err_callback) || err_cnt != 1)
+		error = true;
+	std::cout << "compute_all_comb_native() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+#if defined(__SIZEOF_INT128__)
+	// C(130, 65) fits in unsigned __int128, C(132, 66) does not
+	unsigned __int128 total128 = 0;
+	error = !concurrent_comb::compute_total_comb(130, 65, total128) ||
+		concurrent_permcomb::to_str(total128) != "95067625827960698145584333020095113100" ||
+		concurrent_comb::compute_total_comb(132, 66, total128);
+	std::cout << "compute_total_comb<unsigned __int128>() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+#endif
+}
+
+void unit_test_comb_past_int64()
+{
+	// C(fullset, subset) / 2 and 2^fullset / 2 must not fit in int64_t
+	typedef concurrent_permcomb::int_limits<int_type> limits;
+	if (!limits::is_bounded || limits::digits > 64)
+	{
+		test_threaded_comb_past_int64<int_type>(70, 35);
+		test_threaded_comb_past_int64<int_type>(100, 50);
+		test_threaded_comb_past_int64<int_type>(126, 63);
+	}
+}
+
 void unit_test_comb_by_idx()
 {
 	uint64_t index_to_find = 0;
@@ -6,15 +6,40 @@
 #include "../permcomb/concurrent_perm.h"
 #include "../common/timer.h"
 
+#if defined(__SIZEOF_INT128__)
+// so the tests can print an unsigned __int128 int_type
+std::ostream& operator<<(std::ostream& os, concurrent_permcomb::uint128_type value)
+{
+	return os << concurrent_permcomb::to_str(value);
+}
+#endif
+
 void test_find_perm(uint32_t PermSetSize);
 void unit_test();
 void unit_test_threaded();
 void unit_test_threaded_predicate();
 void unit_test_threaded_shard();
+void unit_test_threaded_chunked();
+void unit_test_threaded_pool();
+void unit_test_threaded_batched();
+void unit_test_threaded_sjt();
+void unit_test_threaded_idx();
+void unit_test_threaded_cancel();
+void unit_test_threaded_multiset();
+void unit_test_threaded_partial();
+void unit_test_threaded_pruned();
 void unit_test_perm_by_idx();
+void unit_test_leftover_set();
+void unit_test_rank_perm();
+void unit_test_perm_past_int64();
+void unit_test_factorial_table();
+void unit_test_threaded_fixed();
 void usage_of_perm_by_idx();
 void usage_of_next_perm();
 void benchmark_perm();
+void benchmark_perm_pool();
+void benchmark_perm_fixed();
+void benchmark_find_perm();
 
 template<typename T>
 bool compare_vec(T& results1, T& results2)
@@ -211,182 +236,1054 @@ bool test_threaded_perm_shard(int_type thread_cnt, uint32_t set_size)
 	return true;
 }
 
-// return false to stop processing
-template<typename container_type>
-struct empty_callback_t
+template<typename int_type>
+bool test_threaded_perm_chunked(int_type thread_cnt, int_type chunk_cnt, uint32_t set_size)
 {
-	bool operator()(const int thread_index, const container_type& cont)
+	std::cout << "test_threaded_perm_chunked(" << thread_cnt << ", " << chunk_cnt << ", " << set_size << ") starting" << std::endl;
+
+	std::vector<char> results(set_size);
+	std::iota(results.begin(), results.end(), 'A');
+
+	std::vector<std::vector< std::vector<char> > > vecvecvec((size_t)thread_cnt);
+
+	concurrent_perm::compute_all_perm_chunked(thread_cnt, chunk_cnt, results,
+		[&vecvecvec](const int thread_index, const std::vector<char>& cont) -> bool
 	{
+		vecvecvec[thread_index].push_back(cont);
 		return true;
+	},
+		[](const int thread_index, const std::vector<char>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	std::vector< std::vector<char> > vecvec;
+	do
+	{
+		vecvec.push_back(std::vector<char>(results.begin(), results.end()));
+	} while (std::next_permutation(results.begin(), results.end()));
+
+	// chunks are claimed in any order, so compare the sorted results
+	std::vector< std::vector<char> > all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
 	}
-};
+	std::sort(all_results.begin(), all_results.end());
 
-template<typename container_type>
-struct error_callback_t
-{
-	void operator()(const int thread_index, const container_type& cont, const std::string& error)
+	bool error = (all_results != vecvec);
+	if (error)
 	{
-		std::cerr << error << std::endl;
+		std::cerr << "Chunked results count " << all_results.size() << " differs from " << vecvec.size() << std::endl;
 	}
-};
+	std::cout << "test_threaded_perm_chunked(" << thread_cnt << ", " << chunk_cnt << ", " << set_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
 
-//typedef boost::multiprecision::cpp_int int_type;
-//typedef boost::multiprecision::int256_t int_type;
-typedef int64_t int_type;
+	return !error;
+}
 
-int main(int argc, char* argv[])
+template<typename int_type>
+bool test_threaded_perm_pool(concurrent_permcomb::thread_pool& pool, int_type thread_cnt, uint32_t set_size)
 {
-	//benchmark_perm();
+	std::cout << "test_threaded_perm_pool(" << thread_cnt << ", " << set_size << ") starting" << std::endl;
 
-	//unit_test();
+	std::vector<char> results(set_size);
+	std::iota(results.begin(), results.end(), 'A');
 
-	//unit_test_threaded();
+	std::vector<std::vector< std::vector<char> > > vecvecvec((size_t)thread_cnt);
 
-	//unit_test_threaded_predicate();
+	concurrent_perm::compute_all_perm(pool, thread_cnt, results,
+		[&vecvecvec](const int thread_index, const std::vector<char>& cont) -> bool
+	{
+		vecvecvec[thread_index].push_back(cont);
+		return true;
+	},
+		[](const int thread_index, const std::vector<char>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
 
-	//unit_test_threaded_shard();
+	std::vector< std::vector<char> > vecvec;
+	do
+	{
+		vecvec.push_back(std::vector<char>(results.begin(), results.end()));
+	} while (std::next_permutation(results.begin(), results.end()));
 
-	//unit_test_perm_by_idx();
+	// compare results
+	size_t cnt = 0;
+	bool error = false;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		for (size_t j = 0; j < vecvecvec[i].size(); ++j, ++cnt)
+		{
+			if (!compare_vec(vecvec[cnt], vecvecvec[i][j]))
+			{
+				error = true;
+				std::cerr << "Perm at " << cnt << " is not the same!" << std::endl;
 
-	usage_of_perm_by_idx();
+				display(vecvec[cnt]);
+				display(vecvecvec[i][j]);
 
-	//usage_of_next_perm();
+				return false;
+			}
+		}
+	}
+	if (cnt != vecvec.size())
+	{
+		error = true;
+		std::cerr << "Perm count " << cnt << " is not " << vecvec.size() << std::endl;
+	}
+	std::cout << "test_threaded_perm_pool(" << thread_cnt << ", " << set_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
 
-	return 0;
+	return !error;
 }
 
-void benchmark_perm()
+// Every callback enumerates a smaller set on the same pool, which runs
+// inline instead of waiting for the busy pool threads
+template<typename int_type>
+bool test_threaded_perm_pool_nested(concurrent_permcomb::thread_pool& pool, int_type thread_cnt, uint32_t set_size, uint32_t inner_size)
 {
-	std::string results(11, 'A');
+	std::cout << "test_threaded_perm_pool_nested(" << thread_cnt << ", " << set_size << ", " << inner_size << ") starting" << std::endl;
+
+	std::vector<char> results(set_size);
 	std::iota(results.begin(), results.end(), 'A');
+	std::vector<char> inner(inner_size);
+	std::iota(inner.begin(), inner.end(), 'a');
 
-	timer stopwatch;
+	std::atomic<int> cnt(0);
+	std::atomic<int> err_cnt(0);
+	auto err_callback = [&err_cnt](const int thread_index, const std::vector<char>& cont, const std::string& error) -> void
 	{
-		std::string results2(results.begin(), results.end());
-
-		stopwatch.start("next_permutation");
-		while (std::next_permutation(results2.begin(), results2.end()))
+		++err_cnt;
+		std::cerr << error;
+	};
+	concurrent_perm::compute_all_perm(pool, thread_cnt, results,
+		[&pool, thread_cnt, &inner, &cnt, err_callback](const int thread_index, const std::vector<char>& cont) -> bool
+	{
+		return concurrent_perm::compute_all_perm(pool, thread_cnt, inner,
+			[&cnt](const int thread_index, const std::vector<char>& cont) -> bool
 		{
+			++cnt;
+			return true;
+		}, err_callback);
+	}, err_callback);
 
-		}
-		stopwatch.stop();
+	int expected = 1;
+	for (uint32_t i = 2; i <= set_size; ++i)
+		expected *= i;
+	for (uint32_t i = 2; i <= inner_size; ++i)
+		expected *= i;
+
+	const bool error = (cnt.load() != expected || err_cnt.load() != 0);
+	if (error)
+	{
+		std::cerr << "Nested perm count " << cnt.load() << " is not " << expected << std::endl;
 	}
+	std::cout << "test_threaded_perm_pool_nested(" << thread_cnt << ", " << set_size << ", " << inner_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
 
-	int_type thread_cnt = 1;
+	return !error;
+}
 
-	typedef empty_callback_t<decltype(results)> callback_t;
-	typedef error_callback_t<decltype(results)> err_callback_t;
+template<typename int_type>
+bool test_threaded_perm_batched(int_type thread_cnt, uint32_t block_size, uint32_t set_size)
+{
+	std::cout << "test_threaded_perm_batched(" << thread_cnt << ", " << block_size << ", " << set_size << ") starting" << std::endl;
 
-	stopwatch.start("1 thread(s)");
-	thread_cnt = 1;
-	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
-	stopwatch.stop();
+	std::vector<char> results(set_size);
+	std::iota(results.begin(), results.end(), 'A');
 
-	stopwatch.start("2 thread(s)");
-	thread_cnt = 2;
-	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
-	stopwatch.stop();
+	std::vector< std::vector<char> > vecvec;
+	do
+	{
+		vecvec.push_back(std::vector<char>(results.begin(), results.end()));
+	} while (std::next_permutation(results.begin(), results.end()));
 
-	stopwatch.start("3 thread(s)");
-	thread_cnt = 3;
-	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
-	stopwatch.stop();
+	// every permutation is stored at its rank, so threads never write the same slot
+	std::vector< std::vector<char> > batched_results(vecvec.size());
 
-	stopwatch.start("4 thread(s)");
-	thread_cnt = 4;
-	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
-	stopwatch.stop();
+	concurrent_perm::compute_all_perm_batched(thread_cnt, block_size, results,
+		[&batched_results](const int thread_index, const char* block, size_t block_cnt, size_t set_size, const int_type& block_start_index) -> bool
+	{
+		for (size_t i = 0; i < block_cnt; ++i)
+		{
+			const char* perm = block + i * set_size;
+			batched_results[static_cast<size_t>(block_start_index) + i].assign(perm, perm + set_size);
+		}
+		return true;
+	},
+		[](const int thread_index, const std::vector<char>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	bool error = (batched_results != vecvec);
+	if (error)
+	{
+		std::cerr << "Batched results differ from std::next_permutation" << std::endl;
+	}
+	std::cout << "test_threaded_perm_batched(" << thread_cnt << ", " << block_size << ", " << set_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
 }
 
-void test_find_perm(uint32_t set_size)
+template<typename int_type>
+bool test_threaded_perm_sjt(int_type thread_cnt, uint32_t set_size)
 {
-	std::cout << "test_find_perm(" << set_size << ") starting" << std::endl;
-	std::vector<uint32_t> results1;
-	std::vector<uint32_t> results2(set_size);
-	std::iota(results2.begin(), results2.end(), 0);
+	std::cout << "test_threaded_perm_sjt(" << thread_cnt << ", " << set_size << ") starting" << std::endl;
 
-	int factorial=0; 
-	concurrent_perm::compute_factorial( set_size, factorial );
+	std::vector<char> results(set_size);
+	std::iota(results.begin(), results.end(), 'A');
 
-	bool error = false;
-	for(int j=0; j<factorial; ++j )
+	std::vector<std::vector< std::vector<char> > > vecvecvec((size_t)thread_cnt);
+	std::vector<char> swap_errors((size_t)thread_cnt, 0);
+
+	concurrent_perm::compute_all_perm_sjt(thread_cnt, results,
+		[&vecvecvec, &swap_errors](const int thread_index, const std::vector<char>& cont, uint32_t pos1, uint32_t pos2) -> bool
 	{
-		if(concurrent_perm::find_perm(set_size, j, results1))
+		std::vector< std::vector<char> >& vecvec = vecvecvec[thread_index];
+		if (vecvec.empty())
 		{
-			if(compare_vec(results1, results2)==false)
-			{
+			if (pos1 != pos2)
+				swap_errors[thread_index] = 1;
+		}
+		else
+		{
+			// the previous permutation with pos1 and pos2 swapped back
+			std::vector<char> prev(cont);
+			std::swap(prev[pos1], prev[pos2]);
+			if ((pos1 + 1 != pos2 && pos2 + 1 != pos1) || prev != vecvec.back())
+				swap_errors[thread_index] = 1;
+		}
+		vecvec.push_back(cont);
+		return true;
+	},
+		[](const int thread_index, const std::vector<char>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+	bool error = std::count(swap_errors.begin(), swap_errors.end(), 1) > 0;
+	if (error)
+	{
+		std::cerr << "Consecutive permutations are not one adjacent swap apart" << std::endl;
+	}
+
+	// threads get their slices in order, so the results are in rank order
+	std::vector< std::vector<char> > all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
+	for (size_t i = 0; i < all_results.size() && !error; ++i)
+	{
+		std::vector<uint32_t> indices;
+		concurrent_perm::find_perm_sjt(set_size, int_type(i), indices);
+		int_type rank = -1;
+		concurrent_perm::rank_perm_sjt(indices, rank);
+		for (size_t k = 0; k < indices.size(); ++k)
+		{
+			if (results[indices[k]] != all_results[i][k])
 				error = true;
-				std::cerr << "Perm at " << j << " is not the same!" << std::endl;
-				display(results1);
-				display(results2);
-				break;
-			}
-			else
-			{
-				//display(results1);
-			}
 		}
-		std::next_permutation(results2.begin(), results2.end());
+		if (rank != int_type(i))
+			error = true;
+		if (error)
+		{
+			std::cerr << "find_perm_sjt/rank_perm_sjt disagree at " << i << std::endl;
+			display(all_results[i]);
+		}
 	}
-	std::cout << "test_find_perm(" << set_size << ") finished with" << ((error)?" errors":" no errors") <<  std::endl;
-}
 
-void unit_test()
-{
-	test_find_perm(3);
-	test_find_perm(4);
-	test_find_perm(5);
-	test_find_perm(6);
-	test_find_perm(7);
-	test_find_perm(8);
-	test_find_perm(9);
-	test_find_perm(10);
-}
+	std::vector< std::vector<char> > vecvec;
+	do
+	{
+		vecvec.push_back(std::vector<char>(results.begin(), results.end()));
+	} while (std::next_permutation(results.begin(), results.end()));
 
-void unit_test_threaded()
-{
-	int_type thread_cnt = 4;
-	test_threaded_perm(thread_cnt, 5);
-	test_threaded_perm(thread_cnt, 6);
-	test_threaded_perm(thread_cnt, 7);
-	test_threaded_perm(thread_cnt, 8);
-	test_threaded_perm(thread_cnt, 9);
-	test_threaded_perm(thread_cnt, 10);
-	thread_cnt = 8;
-	test_threaded_perm(thread_cnt, 2);
-}
+	std::sort(all_results.begin(), all_results.end());
+	if (all_results != vecvec)
+	{
+		error = true;
+		std::cerr << "Perm count " << all_results.size() << " is not " << vecvec.size() << " or has repeats" << std::endl;
+	}
+	std::cout << "test_threaded_perm_sjt(" << thread_cnt << ", " << set_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
 
-void unit_test_threaded_predicate()
-{
-	int_type thread_cnt = 4;
-	test_threaded_perm_predicate(thread_cnt, 5);
-	test_threaded_perm_predicate(thread_cnt, 6);
-	test_threaded_perm_predicate(thread_cnt, 7);
-	test_threaded_perm_predicate(thread_cnt, 8);
-	test_threaded_perm_predicate(thread_cnt, 9);
-	test_threaded_perm_predicate(thread_cnt, 10);
+	return !error;
 }
 
-void unit_test_threaded_shard()
+template<typename int_type>
+bool test_threaded_perm_idx(int_type thread_cnt, uint32_t set_size)
 {
-	int_type thread_cnt = 2;
-	test_threaded_perm_shard(thread_cnt, 4);
-	test_threaded_perm_shard(thread_cnt, 6);
-	test_threaded_perm_shard(thread_cnt, 7);
-	test_threaded_perm_shard(thread_cnt, 8);
-	//thread_cnt = 8;
-	//test_threaded_perm_shard(thread_cnt, 2); // should fail
-}
+	std::cout << "test_threaded_perm_idx(" << thread_cnt << ", " << set_size << ") starting" << std::endl;
 
-void unit_test_perm_by_idx()
-{
-	uint64_t index_to_find = 0;
-	std::string original_text = "12345";
-	std::string std_permuted = "12345";
-	while (true)
+	// heavy elements which the index permutation never copies
+	std::vector<std::string> results(set_size);
+	for (uint32_t i = 0; i < set_size; ++i)
 	{
-		std::string permuted = concurrent_perm::find_perm_by_idx(index_to_find, original_text);
-		if (permuted.size() == 0)
+		results[i] = std::string(20, char('A' + i));
+	}
+
+	typedef concurrent_permcomb::index_view<std::vector<std::string>, concurrent_perm::perm_index_type> view_type;
+	std::vector<std::vector< std::vector<std::string> > > vecvecvec((size_t)thread_cnt);
+
+	concurrent_perm::compute_all_perm_idx(thread_cnt, results,
+		[&vecvecvec](const int thread_index, const view_type& view) -> bool
+	{
+		std::vector<std::string> perm;
+		for (size_t i = 0; i < view.size(); ++i)
+		{
+			perm.push_back(view[i]);
+		}
+		vecvecvec[thread_index].push_back(perm);
+		return true;
+	},
+		[](const int thread_index, const std::vector<std::string>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	std::vector< std::vector<std::string> > vecvec;
+	do
+	{
+		vecvec.push_back(results);
+	} while (std::next_permutation(results.begin(), results.end()));
+
+	std::vector< std::vector<std::string> > all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cerr << "Index permutations differ from std::next_permutation" << std::endl;
+	}
+	std::cout << "test_threaded_perm_idx(" << thread_cnt << ", " << set_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// Search for target and check that finding it stops all threads early
+template<typename int_type>
+bool test_threaded_perm_cancel(int_type thread_cnt, uint32_t set_size, const std::string& target)
+{
+	std::cout << "test_threaded_perm_cancel(" << thread_cnt << ", " << set_size << ", " << target << ") starting" << std::endl;
+
+	std::string results(set_size, 'A');
+	std::iota(results.begin(), results.end(), 'A');
+
+	int_type total = 0;
+	concurrent_perm::compute_factorial(set_size, total);
+
+	std::vector<int_type> visited((size_t)thread_cnt, 0);
+	concurrent_permcomb::cancel_token token;
+
+	concurrent_permcomb::run_status status = concurrent_perm::compute_all_perm(token, thread_cnt, results,
+		[&visited, &target](const int thread_index, const std::string& cont) -> bool
+	{
+		++visited[thread_index];
+		return cont != target; // false trips the token
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	int_type visited_cnt = 0;
+	for (size_t i = 0; i < visited.size(); ++i)
+	{
+		visited_cnt += visited[i];
+	}
+
+	bool error = false;
+	if (status != concurrent_permcomb::run_status::cancelled || !token.is_cancelled())
+	{
+		error = true;
+		std::cerr << "Run was not reported as cancelled" << std::endl;
+	}
+	// a thread may run up to cancel_check_interval results past the hit
+	if (visited_cnt >= total / 2)
+	{
+		error = true;
+		std::cerr << "Visited " << visited_cnt << " of " << total << " after cancel" << std::endl;
+	}
+
+	// a fresh token runs to completion
+	token.reset();
+	int_type all_cnt = 0;
+	status = concurrent_perm::compute_all_perm(token, int_type(1), results,
+		[&all_cnt](const int thread_index, const std::string& cont) -> bool
+	{
+		++all_cnt;
+		return true;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+	if (status != concurrent_permcomb::run_status::completed || all_cnt != total)
+	{
+		error = true;
+		std::cerr << "Run was not reported as completed" << std::endl;
+	}
+
+	// bad thread_cnt goes through err_callback
+	status = concurrent_perm::compute_all_perm(token, int_type(0), results,
+		[](const int thread_index, const std::string& cont) -> bool
+	{
+		return true;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+	});
+	if (status != concurrent_permcomb::run_status::failed)
+	{
+		error = true;
+		std::cerr << "Run was not reported as failed" << std::endl;
+	}
+	std::cout << "test_threaded_perm_cancel(" << thread_cnt << ", " << set_size << ", " << target << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// C(66, 33) arrangements of 33 A's and 33 B's only just fit in int64_t, so
+// neither the total nor find_multiset_perm may overflow on the way there;
+// one more A does not fit and the run must fail through err_callback
+bool test_multiset_perm_too_big()
+{
+	std::cout << "test_multiset_perm_too_big() starting" << std::endl;
+
+	std::vector<uint32_t> group_counts(2, 33);
+	int64_t total = 0;
+	bool error = !concurrent_perm::compute_total_multiset_perm(group_counts, total) || total != INT64_C(7219428434016265740);
+
+	const std::string first = std::string(33, 'A') + std::string(33, 'B');
+	const std::string last = std::string(33, 'B') + std::string(33, 'A');
+	std::string multiset = last;
+	error = error || concurrent_perm::find_multiset_perm_by_idx(int64_t(0), multiset) != first ||
+		concurrent_perm::find_multiset_perm_by_idx(total - 1, multiset) != last ||
+		!concurrent_perm::find_multiset_perm_by_idx(total, multiset).empty();
+
+	++group_counts[0];
+	error = error || concurrent_perm::compute_total_multiset_perm(group_counts, total);
+
+	multiset += 'A';
+	int callback_cnt = 0;
+	int err_cnt = 0;
+	error = error || concurrent_perm::compute_all_multiset_perm(int64_t(4), multiset,
+		[&callback_cnt](const int thread_index, const std::string& cont) -> bool
+	{
+		++callback_cnt;
+		return true;
+	},
+		[&err_cnt](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		++err_cnt;
+	});
+	error = error || callback_cnt != 0 || err_cnt != 1;
+	std::cout << "test_multiset_perm_too_big() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_threaded_multiset_perm(int_type thread_cnt, const std::string& multiset)
+{
+	std::cout << "test_threaded_multiset_perm(" << thread_cnt << ", " << multiset << ") starting" << std::endl;
+
+	std::vector<std::vector<std::string> > vecvecvec((size_t)thread_cnt);
+
+	concurrent_perm::compute_all_multiset_perm(thread_cnt, multiset,
+		[&vecvecvec](const int thread_index, const std::string& cont) -> bool
+	{
+		vecvecvec[thread_index].push_back(cont);
+		return true;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	std::string results(multiset);
+	std::sort(results.begin(), results.end());
+	std::vector<std::string> vecvec;
+	do
+	{
+		vecvec.push_back(results);
+	} while (std::next_permutation(results.begin(), results.end()));
+
+	std::vector<std::string> all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cerr << "Multiset perm count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	for (size_t i = 0; i < vecvec.size() && !error; ++i)
+	{
+		if (concurrent_perm::find_multiset_perm_by_idx(int_type(i), results) != vecvec[i])
+		{
+			error = true;
+			std::cerr << "find_multiset_perm_by_idx(" << i << ") is not " << vecvec[i] << std::endl;
+		}
+	}
+	std::cout << "test_threaded_multiset_perm(" << thread_cnt << ", " << multiset << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// nPr(20, 20) = 20! fits in int64_t but nPr(30, 15) does not, so the
+// latter must fail through err_callback before any selection is visited
+bool test_partial_perm_too_big()
+{
+	std::cout << "test_partial_perm_too_big() starting" << std::endl;
+
+	int64_t total = 0;
+	bool error = !concurrent_perm::compute_total_partial_perm(20, 20, total) || total != INT64_C(2432902008176640000) ||
+		concurrent_perm::compute_total_partial_perm(30, 15, total);
+
+	std::vector<uint32_t> results(20);
+	std::iota(results.begin(), results.end(), 0);
+	const std::vector<uint32_t> last(results.rbegin(), results.rend());
+	error = error || concurrent_perm::find_partial_perm_by_idx(20, INT64_C(2432902008176640000) - 1, results) != last;
+
+	results.resize(30);
+	std::iota(results.begin(), results.end(), 0);
+	int callback_cnt = 0;
+	int err_cnt = 0;
+	error = error || !concurrent_perm::find_partial_perm_by_idx(15, int64_t(0), results).empty() ||
+		concurrent_perm::compute_all_partial_perm(int64_t(4), 15, results,
+		[&callback_cnt](const int thread_index, const std::vector<uint32_t>& cont) -> bool
+	{
+		++callback_cnt;
+		return true;
+	},
+		[&err_cnt](const int thread_index, const std::vector<uint32_t>& cont, const std::string& error) -> void
+	{
+		++err_cnt;
+	});
+	error = error || callback_cnt != 0 || err_cnt != 1;
+	std::cout << "test_partial_perm_too_big() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_threaded_partial_perm(int_type thread_cnt, uint32_t set_size, uint32_t r)
+{
+	std::cout << "test_threaded_partial_perm(" << thread_cnt << ", " << set_size << ", " << r << ") starting" << std::endl;
+
+	std::string results(set_size, 'A');
+	std::iota(results.begin(), results.end(), 'A');
+
+	std::vector<std::vector<std::string> > vecvecvec((size_t)thread_cnt);
+
+	concurrent_perm::compute_all_partial_perm(thread_cnt, r, results,
+		[&vecvecvec](const int thread_index, const std::string& cont) -> bool
+	{
+		vecvecvec[thread_index].push_back(cont);
+		return true;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	// the distinct prefixes of all full permutations, in order
+	std::vector<std::string> vecvec;
+	do
+	{
+		std::string prefix = results.substr(0, r);
+		if (vecvec.empty() || vecvec.back() != prefix)
+			vecvec.push_back(prefix);
+	} while (std::next_permutation(results.begin(), results.end()));
+
+	std::vector<std::string> all_results;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cerr << "Partial perm count " << all_results.size() << " is not " << vecvec.size() << " or out of order" << std::endl;
+	}
+	for (size_t i = 0; i < vecvec.size() && !error; ++i)
+	{
+		if (concurrent_perm::find_partial_perm_by_idx(r, int_type(i), results) != vecvec[i])
+		{
+			error = true;
+			std::cerr << "find_partial_perm_by_idx(" << i << ") is not " << vecvec[i] << std::endl;
+		}
+	}
+	std::cout << "test_threaded_partial_perm(" << thread_cnt << ", " << set_size << ", " << r << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// Keeps the permutations where none of the first fixed_cnt elements is in
+// its sorted position, pruning a prefix as soon as one is
+template<typename int_type>
+bool test_threaded_perm_pruned(int_type thread_cnt, uint32_t set_size, uint32_t fixed_cnt)
+{
+	std::cout << "test_threaded_perm_pruned(" << thread_cnt << ", " << set_size << ", " << fixed_cnt << ") starting" << std::endl;
+
+	std::string results(set_size, 'A');
+	std::iota(results.begin(), results.end(), 'A');
+
+	std::vector<std::vector<std::string> > vecvecvec((size_t)thread_cnt);
+	std::vector<std::string> prev_perms((size_t)thread_cnt);
+	std::vector<int_type> call_cnts((size_t)thread_cnt, 0);
+	std::vector<char> pos_errors((size_t)thread_cnt, 0);
+
+	concurrent_perm::compute_all_perm_pruned(thread_cnt, results,
+		[&](const int thread_index, const std::string& cont, uint32_t changed_pos, uint32_t& prune_len) -> bool
+	{
+		++call_cnts[thread_index];
+		std::string& prev = prev_perms[thread_index];
+		if (!prev.empty() && (prev.compare(0, changed_pos, cont, 0, changed_pos) != 0 || prev[changed_pos] == cont[changed_pos]))
+			pos_errors[thread_index] = 1;
+		prev = cont;
+
+		for (uint32_t p = 0; p < fixed_cnt; ++p)
+		{
+			if (cont[p] == char('A' + p))
+			{
+				prune_len = p + 1;
+				return true;
+			}
+		}
+		vecvecvec[thread_index].push_back(cont);
+		return true;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	std::vector<std::string> vecvec;
+	int_type total = 0;
+	do
+	{
+		++total;
+		bool keep = true;
+		for (uint32_t p = 0; p < fixed_cnt; ++p)
+		{
+			if (results[p] == char('A' + p))
+				keep = false;
+		}
+		if (keep)
+			vecvec.push_back(results);
+	} while (std::next_permutation(results.begin(), results.end()));
+
+	std::vector<std::string> all_results;
+	int_type call_cnt = 0;
+	for (size_t i = 0; i < vecvecvec.size(); ++i)
+	{
+		all_results.insert(all_results.end(), vecvecvec[i].begin(), vecvecvec[i].end());
+		call_cnt += call_cnts[i];
+	}
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cerr << "Pruned results count " << all_results.size() << " is not " << vecvec.size() << std::endl;
+	}
+	if (std::count(pos_errors.begin(), pos_errors.end(), 1) > 0)
+	{
+		error = true;
+		std::cerr << "changed_pos is wrong" << std::endl;
+	}
+	std::cout << "test_threaded_perm_pruned(" << thread_cnt << ", " << set_size << ", " << fixed_cnt << ") visited " << call_cnt << " of " << total <<
+		" and finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// return false to stop processing
+template<typename container_type>
+struct empty_callback_t
+{
+	bool operator()(const int thread_index, const container_type& cont)
+	{
+		return true;
+	}
+};
+
+template<typename container_type>
+struct error_callback_t
+{
+	void operator()(const int thread_index, const container_type& cont, const std::string& error)
+	{
+		std::cerr << error << std::endl;
+	}
+};
+
+//typedef boost::multiprecision::cpp_int int_type;
+//typedef boost::multiprecision::int256_t int_type;
+//typedef unsigned __int128 int_type; // GCC and Clang, up to 34!
+typedef int64_t int_type;
+
+int main(int argc, char* argv[])
+{
+	//benchmark_perm();
+
+	//benchmark_perm_pool();
+
+	//benchmark_perm_fixed();
+
+	//unit_test();
+
+	//unit_test_threaded();
+
+	//unit_test_threaded_predicate();
+
+	//unit_test_threaded_shard();
+
+	//unit_test_threaded_chunked();
+
+	//unit_test_threaded_pool();
+
+	//unit_test_threaded_batched();
+
+	//unit_test_threaded_sjt();
+
+	//unit_test_threaded_idx();
+
+	//unit_test_threaded_cancel();
+
+	//unit_test_threaded_multiset();
+
+	//unit_test_threaded_partial();
+
+	//unit_test_threaded_pruned();
+
+	//unit_test_perm_by_idx();
+
+	//unit_test_leftover_set();
+
+	//unit_test_rank_perm();
+
+	//unit_test_perm_past_int64();
+
+	//unit_test_factorial_table();
+
+	//unit_test_threaded_fixed();
+
+	//benchmark_find_perm();
+
+	usage_of_perm_by_idx();
+
+	//usage_of_next_perm();
+
+	return 0;
+}
+
+void benchmark_perm()
+{
+	std::string results(11, 'A');
+	std::iota(results.begin(), results.end(), 'A');
+
+	timer stopwatch;
+	{
+		std::string results2(results.begin(), results.end());
+
+		stopwatch.start("next_permutation");
+		while (std::next_permutation(results2.begin(), results2.end()))
+		{
+
+		}
+		stopwatch.stop();
+	}
+
+	int_type thread_cnt = 1;
+
+	typedef empty_callback_t<decltype(results)> callback_t;
+	typedef error_callback_t<decltype(results)> err_callback_t;
+
+	stopwatch.start("1 thread(s)");
+	thread_cnt = 1;
+	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
+	stopwatch.stop();
+
+	stopwatch.start("2 thread(s)");
+	thread_cnt = 2;
+	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
+	stopwatch.stop();
+
+	stopwatch.start("3 thread(s)");
+	thread_cnt = 3;
+	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
+	stopwatch.stop();
+
+	stopwatch.start("4 thread(s)");
+	thread_cnt = 4;
+	concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
+	stopwatch.stop();
+}
+
+// compute_all_perm against compute_all_perm_fixed on the same 11 elements
+// as benchmark_perm. The callbacks add up one element, so the compiler
+// cannot drop the fixed-size loop altogether.
+void benchmark_perm_fixed()
+{
+	std::array<char, 11> results;
+	std::iota(results.begin(), results.end(), 'A');
+	const std::string results_str(results.begin(), results.end());
+
+	std::vector<uint64_t> sums(4, 0);
+	timer stopwatch;
+	for (int_type thread_cnt = 1; thread_cnt <= 4; ++thread_cnt)
+	{
+		std::ostringstream oss;
+		oss << thread_cnt << " thread(s)";
+		stopwatch.start(oss.str());
+		concurrent_perm::compute_all_perm(thread_cnt, results_str,
+			[&sums](const int thread_index, const std::string& cont) -> bool
+		{
+			sums[thread_index] += cont[10];
+			return true;
+		}, error_callback_t<std::string>());
+		stopwatch.stop();
+	}
+	for (int_type thread_cnt = 1; thread_cnt <= 4; ++thread_cnt)
+	{
+		std::ostringstream oss;
+		oss << thread_cnt << " thread(s) fixed";
+		stopwatch.start(oss.str());
+		concurrent_perm::compute_all_perm_fixed(thread_cnt, results,
+			[&sums](const int thread_index, const std::array<char, 11>& cont) -> bool
+		{
+			sums[thread_index] += cont[10];
+			return true;
+		}, error_callback_t<std::array<char, 11> >());
+		stopwatch.stop();
+	}
+	std::cout << "checksum: " << std::accumulate(sums.begin(), sums.end(), uint64_t(0)) << std::endl;
+}
+
+void benchmark_perm_pool()
+{
+	std::string results(6, 'A');
+	std::iota(results.begin(), results.end(), 'A');
+
+	int_type thread_cnt = 4;
+	const int repeat = 10000;
+
+	typedef empty_callback_t<decltype(results)> callback_t;
+	typedef error_callback_t<decltype(results)> err_callback_t;
+
+	timer stopwatch;
+	stopwatch.start("spawn threads");
+	for (int i = 0; i < repeat; ++i)
+	{
+		concurrent_perm::compute_all_perm(thread_cnt, results, callback_t(), err_callback_t());
+	}
+	stopwatch.stop();
+
+	concurrent_permcomb::thread_pool pool(static_cast<int>(thread_cnt));
+	stopwatch.start("thread pool");
+	for (int i = 0; i < repeat; ++i)
+	{
+		concurrent_perm::compute_all_perm(pool, thread_cnt, results, callback_t(), err_callback_t());
+	}
+	stopwatch.stop();
+}
+
+void test_find_perm(uint32_t set_size)
+{
+	std::cout << "test_find_perm(" << set_size << ") starting" << std::endl;
+	std::vector<uint32_t> results1;
+	std::vector<uint32_t> results2(set_size);
+	std::iota(results2.begin(), results2.end(), 0);
+
+	int factorial=0; 
+	concurrent_perm::compute_factorial( set_size, factorial );
+
+	bool error = false;
+	for(int j=0; j<factorial; ++j )
+	{
+		if(concurrent_perm::find_perm(set_size, j, results1))
+		{
+			if(compare_vec(results1, results2)==false)
+			{
+				error = true;
+				std::cerr << "Perm at " << j << " is not the same!" << std::endl;
+				display(results1);
+				display(results2);
+				break;
+			}
+			else
+			{
+				//display(results1);
+			}
+		}
+		std::next_permutation(results2.begin(), results2.end());
+	}
+	std::cout << "test_find_perm(" << set_size << ") finished with" << ((error)?" errors":" no errors") <<  std::endl;
+}
+
+void unit_test()
+{
+	test_find_perm(3);
+	test_find_perm(4);
+	test_find_perm(5);
+	test_find_perm(6);
+	test_find_perm(7);
+	test_find_perm(8);
+	test_find_perm(9);
+	test_find_perm(10);
+}
+
+void unit_test_threaded()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm(thread_cnt, 5);
+	test_threaded_perm(thread_cnt, 6);
+	test_threaded_perm(thread_cnt, 7);
+	test_threaded_perm(thread_cnt, 8);
+	test_threaded_perm(thread_cnt, 9);
+	test_threaded_perm(thread_cnt, 10);
+	thread_cnt = 8;
+	test_threaded_perm(thread_cnt, 2);
+}
+
+void unit_test_threaded_predicate()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_predicate(thread_cnt, 5);
+	test_threaded_perm_predicate(thread_cnt, 6);
+	test_threaded_perm_predicate(thread_cnt, 7);
+	test_threaded_perm_predicate(thread_cnt, 8);
+	test_threaded_perm_predicate(thread_cnt, 9);
+	test_threaded_perm_predicate(thread_cnt, 10);
+}
+
+void unit_test_threaded_shard()
+{
+	int_type thread_cnt = 2;
+	test_threaded_perm_shard(thread_cnt, 4);
+	test_threaded_perm_shard(thread_cnt, 6);
+	test_threaded_perm_shard(thread_cnt, 7);
+	test_threaded_perm_shard(thread_cnt, 8);
+	//thread_cnt = 8;
+	//test_threaded_perm_shard(thread_cnt, 2); // should fail
+}
+
+void unit_test_threaded_chunked()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_chunked(thread_cnt, int_type(1), 5);
+	test_threaded_perm_chunked(thread_cnt, int_type(7), 6);
+	test_threaded_perm_chunked(thread_cnt, int_type(64), 7);
+	test_threaded_perm_chunked(thread_cnt, int_type(1000), 8);
+	test_threaded_perm_chunked(thread_cnt, int_type(100000), 4); // more chunks than permutations
+}
+
+void unit_test_threaded_pool()
+{
+	int_type thread_cnt = 4;
+	concurrent_permcomb::thread_pool pool(static_cast<int>(thread_cnt));
+	// the same parked threads serve every call
+	test_threaded_perm_pool(pool, thread_cnt, 5);
+	test_threaded_perm_pool(pool, thread_cnt, 6);
+	test_threaded_perm_pool(pool, thread_cnt, 7);
+	test_threaded_perm_pool(pool, int_type(2), 8);
+	test_threaded_perm_pool(pool, thread_cnt, 2);
+	for (int i = 0; i < 100; ++i)
+	{
+		if (!test_threaded_perm_pool(pool, thread_cnt, 4))
+			break;
+	}
+	test_threaded_perm_pool_nested(pool, thread_cnt, 5, 4);
+	test_threaded_perm_pool_nested(pool, int_type(1), 4, 3);
+}
+
+void unit_test_threaded_batched()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_batched(thread_cnt, 1, 5);
+	test_threaded_perm_batched(thread_cnt, 7, 6);
+	test_threaded_perm_batched(thread_cnt, 64, 7);
+	test_threaded_perm_batched(thread_cnt, 1000, 8); // block larger than a thread's slice
+	test_threaded_perm_batched(int_type(1), 16, 4);
+}
+
+void unit_test_threaded_sjt()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_sjt(int_type(1), 1);
+	test_threaded_perm_sjt(int_type(1), 3);
+	test_threaded_perm_sjt(thread_cnt, 4);
+	test_threaded_perm_sjt(thread_cnt, 5);
+	test_threaded_perm_sjt(thread_cnt, 6);
+	test_threaded_perm_sjt(thread_cnt, 7);
+	test_threaded_perm_sjt(thread_cnt, 8);
+}
+
+void unit_test_threaded_idx()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_idx(thread_cnt, 5);
+	test_threaded_perm_idx(thread_cnt, 6);
+	test_threaded_perm_idx(thread_cnt, 7);
+	test_threaded_perm_idx(thread_cnt, 8);
+	test_threaded_perm_idx(int_type(8), 2);
+}
+
+void unit_test_threaded_cancel()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_cancel(thread_cnt, 9, "ABCDEFGHI"); // first permutation
+	test_threaded_perm_cancel(thread_cnt, 9, "ABDCEFGHI"); // early in the first slice
+	test_threaded_perm_cancel(thread_cnt, 10, "IABCDEFGHJ"); // early in the last slice
+}
+
+void unit_test_threaded_multiset()
+{
+	int_type thread_cnt = 4;
+	test_threaded_multiset_perm(thread_cnt, "ABCDE"); // no duplicates
+	test_threaded_multiset_perm(thread_cnt, "AABBC");
+	test_threaded_multiset_perm(thread_cnt, "CBABCAB");
+	test_threaded_multiset_perm(thread_cnt, "AAAABBBBCCD");
+	test_threaded_multiset_perm(int_type(1), "AAAA");
+	test_multiset_perm_too_big();
+}
+
+void unit_test_threaded_partial()
+{
+	int_type thread_cnt = 4;
+	test_threaded_partial_perm(thread_cnt, 6, 3);
+	test_threaded_partial_perm(thread_cnt, 7, 2);
+	test_threaded_partial_perm(thread_cnt, 8, 1);
+	test_threaded_partial_perm(thread_cnt, 5, 5);
+	test_threaded_partial_perm(thread_cnt, 9, 4);
+	test_threaded_partial_perm(int_type(1), 4, 2);
+	test_partial_perm_too_big();
+}
+
+void unit_test_threaded_pruned()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_pruned(thread_cnt, 5, 0); // nothing pruned
+	test_threaded_perm_pruned(thread_cnt, 6, 1);
+	test_threaded_perm_pruned(thread_cnt, 7, 3);
+	test_threaded_perm_pruned(thread_cnt, 9, 4);
+	test_threaded_perm_pruned(thread_cnt, 6, 6); // derangements
+	test_threaded_perm_pruned(int_type(1), 8, 2);
+}
+
+void unit_test_perm_by_idx()
+{
+	uint64_t index_to_find = 0;
+	std::string original_text = "12345";
+	std::string std_permuted = "12345";
+	while (true)
+	{
+		std::string permuted = concurrent_perm::find_perm_by_idx(index_to_find, original_text);
+		if (permuted.size() == 0)
 		{
 			std::cout << "Ended at index: " << index_to_find << std::endl;
 			break;
@@ -402,6 +1299,467 @@ void unit_test_perm_by_idx()
 
 }
 
+void unit_test_leftover_set()
+{
+	// set sizes up to 64 use the bitmask, larger ones the Fenwick tree
+	uint32_t set_sizes[] = { 1, 7, 63, 64, 65, 100, 257 };
+	bool error = false;
+	for (uint32_t set_size : set_sizes)
+	{
+		concurrent_perm::leftover_set leftovers(set_size);
+		std::vector<uint32_t> expected(set_size);
+		std::iota(expected.begin(), expected.end(), 0);
+		uint32_t seed = set_size;
+		while (!expected.empty())
+		{
+			seed = seed * 1103515245 + 12345;
+			uint32_t k = (seed >> 8) % expected.size();
+			if (leftovers.take(k) != expected[k])
+			{
+				error = true;
+				std::cerr << "leftover_set(" << set_size << ") take(" << k << ") is wrong" << std::endl;
+				break;
+			}
+			expected.erase(expected.begin() + k);
+		}
+	}
+	std::cout << "unit_test_leftover_set() finished with" << ((error) ? " errors" : " no errors") << std::endl;
+}
+
+// rank_perm must undo find_perm, for every index of small sets and for
+// random permutations of sets large enough for the Fenwick tree
+// The second half of set_size! starts past int64_t, so its slice is counted
+// on uint64_t sub-ranges. Check the first sample_cnt results against
+// find_perm_by_idx, and the sub-range cuts of a slice past uint64_t.
+template<typename int_type>
+bool test_threaded_perm_past_int64(uint32_t set_size, uint32_t sample_cnt)
+{
+	std::cout << "test_threaded_perm_past_int64(" << set_size << ", " << sample_cnt << ") starting" << std::endl;
+
+	std::string results(set_size, 'A');
+	std::iota(results.begin(), results.end(), 'A');
+	const concurrent_perm::factorial_table<int_type> factorials(set_size);
+	const int_type cpu_cnt = 2;
+	const int_type start_index = factorials[set_size] / cpu_cnt;
+
+	std::vector<std::string> vec;
+	concurrent_perm::compute_all_perm_shard(int_type(1), cpu_cnt, int_type(1), results,
+		[&vec, sample_cnt](const int thread_index, const std::string& cont) -> bool
+	{
+		vec.push_back(cont);
+		return vec.size() < sample_cnt;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	bool error = (vec.size() != sample_cnt);
+	for (uint32_t i = 0; i < vec.size(); ++i)
+	{
+		if (vec[i] != concurrent_perm::find_perm_by_idx(factorials, int_type(start_index + i), results))
+		{
+			std::cerr << "Wrong permutation at index " << (start_index + i) << std::endl;
+			error = true;
+			break;
+		}
+	}
+
+	// block ranks are absolute although the loop counts from its sub-range
+	std::vector<int_type> block_starts;
+	std::string block_perms;
+	concurrent_perm::compute_all_perm_batched_shard(int_type(1), cpu_cnt, int_type(1), 7, results,
+		[&block_starts, &block_perms](const int thread_index, const char* block, size_t block_cnt, size_t set_size, const int_type& block_start_index) -> bool
+	{
+		block_starts.push_back(block_start_index);
+		block_perms.append(block, block_cnt * set_size);
+		return block_starts.size() < 3;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+	for (uint32_t i = 0; i < block_starts.size(); ++i)
+	{
+		if (block_starts[i] != start_index + int_type(i * 7) ||
+			block_perms.substr(i * 7 * set_size, set_size) != concurrent_perm::find_perm_by_idx(factorials, int_type(block_starts[i]), results))
+		{
+			std::cerr << "Wrong block at index " << block_starts[i] << std::endl;
+			error = true;
+			break;
+		}
+	}
+
+	// pruning by the first element jumps (set_size - 1)! at a time, across
+	// many uint64_t sub-ranges, until the end of the slice
+	std::vector<std::string> pruned;
+	concurrent_perm::compute_all_perm_pruned_shard(int_type(1), cpu_cnt, int_type(1), results,
+		[&pruned](const int thread_index, const std::string& cont, uint32_t changed_pos, uint32_t& prune_len) -> bool
+	{
+		pruned.push_back(cont);
+		prune_len = 1;
+		return true;
+	},
+		[](const int thread_index, const std::string& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+	int_type pruned_index = start_index;
+	for (uint32_t i = 0; !error; ++i)
+	{
+		if (pruned_index >= factorials[set_size])
+		{
+			if (i != pruned.size())
+			{
+				std::cerr << "Pruned permutation count " << pruned.size() << " is not " << i << std::endl;
+				error = true;
+			}
+			break;
+		}
+		if (i >= pruned.size() || pruned[i] != concurrent_perm::find_perm_by_idx(factorials, pruned_index, results))
+		{
+			std::cerr << "Wrong pruned permutation at index " << pruned_index << std::endl;
+			error = true;
+		}
+		pruned_index = (pruned_index / factorials[set_size - 1] + 1) * factorials[set_size - 1];
+	}
+
+	const uint64_t max_cnt = std::numeric_limits<uint64_t>::max();
+	const int_type end_index = start_index + int_type(max_cnt) * 2 + 5;
+	std::vector<uint64_t> cnts;
+	concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&cnts](uint64_t cnt) -> bool
+	{
+		cnts.push_back(cnt);
+		return true;
+	});
+	if (cnts.size() != 3 || cnts[0] != max_cnt || cnts[1] != max_cnt || cnts[2] != 5)
+	{
+		std::cerr << "run_native_sub_ranges cut the range wrongly" << std::endl;
+		error = true;
+	}
+	std::cout << "test_threaded_perm_past_int64(" << set_size << ", " << sample_cnt << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type, size_t N>
+bool test_threaded_perm_fixed(int_type cpu_cnt, int_type thread_cnt)
+{
+	std::cout << "test_threaded_perm_fixed(" << cpu_cnt << ", " << thread_cnt << ", " << N << ") starting" << std::endl;
+
+	std::array<char, N> results;
+	std::iota(results.begin(), results.end(), 'A');
+
+	typedef std::array<char, N> array_type;
+	std::vector<std::vector<std::vector<array_type> > > vecvecvec((size_t)cpu_cnt, std::vector<std::vector<array_type> >((size_t)thread_cnt));
+	for (int_type cpu_index = 0; cpu_index < cpu_cnt; ++cpu_index)
+	{
+		std::vector<std::vector<array_type> >& vecvec = vecvecvec[(size_t)cpu_index];
+		concurrent_perm::compute_all_perm_fixed_shard(cpu_index, cpu_cnt, thread_cnt, results,
+			[&vecvec](const int thread_index, const array_type& cont) -> bool
+		{
+			vecvec[thread_index].push_back(cont);
+			return true;
+		},
+			[](const int thread_index, const array_type& cont, const std::string& error) -> void
+		{
+			std::cerr << error;
+		});
+	}
+
+	std::vector<array_type> all_results;
+	for (size_t k = 0; k < vecvecvec.size(); ++k)
+	{
+		for (size_t i = 0; i < vecvecvec[k].size(); ++i)
+		{
+			all_results.insert(all_results.end(), vecvecvec[k][i].begin(), vecvecvec[k][i].end());
+		}
+	}
+
+	std::vector<array_type> vecvec;
+	do
+	{
+		vecvec.push_back(results);
+	} while (std::next_permutation(results.begin(), results.end()));
+
+	bool error = (all_results != vecvec);
+	if (error)
+	{
+		std::cerr << "Results count " << all_results.size() << " is not " << vecvec.size() << " or results differ" << std::endl;
+	}
+	std::cout << "test_threaded_perm_fixed(" << cpu_cnt << ", " << thread_cnt << ", " << N << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// find_perm_fixed and next_perm_fixed against find_perm_by_idx at
+// sample_cnt indices spread over the N! permutations
+template<size_t N>
+bool test_find_perm_fixed(uint32_t sample_cnt)
+{
+	std::cout << "test_find_perm_fixed(" << N << ", " << sample_cnt << ") starting" << std::endl;
+
+	std::array<char, N> sorted;
+	std::iota(sorted.begin(), sorted.end(), 'A');
+	std::string text(sorted.begin(), sorted.end());
+	const concurrent_perm::factorial_table<uint64_t> factorials(N);
+	const uint64_t step = factorials[N] / sample_cnt;
+
+	bool error = false;
+	for (uint32_t i = 0; i < sample_cnt && !error; ++i)
+	{
+		const uint64_t index = i * step + i % 7;
+		std::array<char, N> results;
+		std::array<uint8_t, N> digits;
+		concurrent_perm::find_perm_fixed(sorted, index, results, digits);
+		for (uint64_t k = index; k < index + 8 && k < factorials[N] && !error; ++k)
+		{
+			if (std::string(results.begin(), results.end()) != concurrent_perm::find_perm_by_idx(factorials, k, text))
+			{
+				std::cerr << "Wrong permutation at index " << k << std::endl;
+				error = true;
+			}
+			concurrent_perm::next_perm_fixed(results, digits);
+		}
+	}
+	std::cout << "test_find_perm_fixed(" << N << ", " << sample_cnt << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// N past 20 falls back to compute_all_perm_shard, so int_type must hold N!
+template<typename int_type, size_t N>
+bool test_perm_fixed_fallback(uint32_t sample_cnt)
+{
+	std::cout << "test_perm_fixed_fallback(" << N << ", " << sample_cnt << ") starting" << std::endl;
+
+	std::array<char, N> results;
+	std::iota(results.begin(), results.end(), 'A');
+	std::string text(results.begin(), results.end());
+	const concurrent_perm::factorial_table<int_type> factorials(N);
+	const int_type cpu_cnt = 2;
+	const int_type start_index = factorials[N] / cpu_cnt;
+
+	std::vector<std::array<char, N> > vec;
+	concurrent_perm::compute_all_perm_fixed_shard(int_type(1), cpu_cnt, int_type(1), results,
+		[&vec, sample_cnt](const int thread_index, const std::array<char, N>& cont) -> bool
+	{
+		vec.push_back(cont);
+		return vec.size() < sample_cnt;
+	},
+		[](const int thread_index, const std::array<char, N>& cont, const std::string& error) -> void
+	{
+		std::cerr << error;
+	});
+
+	bool error = (vec.size() != sample_cnt);
+	for (uint32_t i = 0; i < vec.size() && !error; ++i)
+	{
+		if (std::string(vec[i].begin(), vec[i].end()) != concurrent_perm::find_perm_by_idx(factorials, int_type(start_index + i), text))
+		{
+			std::cerr << "Wrong permutation at index " << (start_index + i) << std::endl;
+			error = true;
+		}
+	}
+	std::cout << "test_perm_fixed_fallback(" << N << ", " << sample_cnt << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+
+	return !error;
+}
+
+// factorial_table and compute_factorial read the compile-time table up to
+// native_tables<T>::max_factorial; check them against plain multiplication.
+template<typename T>
+bool test_factorial_table(uint32_t max_num)
+{
+	const concurrent_perm::factorial_table<T> factorials(max_num);
+	bool error = false;
+	T expected = 1;
+	for (uint32_t i = 0; i <= max_num; ++i)
+	{
+		if (i > 1)
+			expected = expected * T(i);
+		T factorial = 0;
+		concurrent_perm::compute_factorial(i, factorial);
+		if (factorials[i] != expected || factorial != expected)
+		{
+			std::cerr << "factorial of " << i << " is wrong" << std::endl;
+			error = true;
+		}
+	}
+	std::cout << "test_factorial_table(" << max_num << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_rank_perm(uint32_t set_size, uint32_t sample_cnt)
+{
+	std::cout << "test_rank_perm(" << set_size << ") starting" << std::endl;
+	concurrent_perm::factorial_table<int_type> factorials(set_size);
+	std::vector<uint32_t> perm(set_size);
+	std::iota(perm.begin(), perm.end(), 0);
+	uint32_t seed = set_size;
+
+	bool error = false;
+	for (uint32_t j = 0; j < sample_cnt && !error; ++j)
+	{
+		int_type rank = 0;
+		std::vector<uint32_t> found;
+		if (!concurrent_perm::rank_perm(factorials, perm, rank) ||
+			!concurrent_perm::find_perm(factorials, set_size, rank, found) || found != perm)
+		{
+			error = true;
+			std::cerr << "rank_perm(" << set_size << ") is wrong" << std::endl;
+			display(perm);
+		}
+		if (sample_cnt == factorials[set_size] && rank != int_type(j))
+		{
+			error = true;
+			std::cerr << "rank_perm(" << set_size << ") is " << rank << " instead of " << j << std::endl;
+		}
+
+		if (sample_cnt == factorials[set_size])
+		{
+			std::next_permutation(perm.begin(), perm.end());
+		}
+		else
+		{
+			for (uint32_t i = set_size - 1; i > 0; --i)
+			{
+				seed = seed * 1103515245 + 12345;
+				std::swap(perm[i], perm[(seed >> 8) % (i + 1)]);
+			}
+		}
+	}
+
+	// not permutations
+	int_type rank = 0;
+	std::vector<uint32_t> bad(set_size, 0);
+	if (set_size > 1 && concurrent_perm::rank_perm(factorials, bad, rank))
+	{
+		error = true;
+		std::cerr << "rank_perm(" << set_size << ") accepted repeats" << std::endl;
+	}
+	std::cout << "test_rank_perm(" << set_size << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+template<typename int_type>
+bool test_rank_perm_bulk(int_type thread_cnt)
+{
+	std::cout << "test_rank_perm_bulk(" << thread_cnt << ") starting" << std::endl;
+	std::string original = "ABCDEFG";
+	std::vector<std::string> perms;
+	std::string perm = original;
+	do
+	{
+		perms.push_back(perm);
+	} while (std::next_permutation(perm.begin(), perm.end()));
+	std::reverse(perms.begin(), perms.end());
+	perms.push_back("ABCDEFF"); // not a permutation
+	perms.push_back("ABCDEFGH");
+
+	std::vector<int_type> ranks;
+	bool error = concurrent_perm::rank_perm_bulk(thread_cnt, original, perms, ranks);
+	const int_type total = static_cast<int_type>(perms.size() - 2);
+	for (size_t i = 0; i < perms.size() - 2; ++i)
+	{
+		if (ranks[i] != total - 1 - static_cast<int_type>(i))
+			error = true;
+	}
+	const int_type invalid = static_cast<int_type>(-1);
+	if (ranks[perms.size() - 2] != invalid || ranks[perms.size() - 1] != invalid)
+		error = true;
+	std::cout << "test_rank_perm_bulk(" << thread_cnt << ") finished with" << ((error) ? " errors" : " no errors") << std::endl;
+	return !error;
+}
+
+void unit_test_rank_perm()
+{
+	for (uint32_t set_size = 1; set_size <= 8; ++set_size)
+	{
+		int_type total = 0;
+		concurrent_perm::compute_factorial(set_size, total);
+		test_rank_perm<int_type>(set_size, static_cast<uint32_t>(total));
+	}
+	test_rank_perm<int_type>(20, 1000);
+	if (!concurrent_permcomb::int_limits<int_type>::is_bounded)
+	{
+		test_rank_perm<int_type>(21, 1000);
+		test_rank_perm<int_type>(64, 1000);
+		test_rank_perm<int_type>(65, 1000);
+		test_rank_perm<int_type>(300, 100);
+	}
+	test_rank_perm_bulk(int_type(4));
+	test_rank_perm_bulk(int_type(1));
+}
+
+void unit_test_perm_past_int64()
+{
+	// set_size! must not fit in int64_t, 34! is the largest in unsigned __int128
+	typedef concurrent_permcomb::int_limits<int_type> limits;
+	if (!limits::is_bounded || limits::digits > 64)
+	{
+		test_threaded_perm_past_int64<int_type>(21, 1000);
+		test_threaded_perm_past_int64<int_type>(30, 1000);
+		test_threaded_perm_past_int64<int_type>(34, 1000);
+	}
+}
+
+void unit_test_factorial_table()
+{
+	test_factorial_table<int32_t>(12);
+	test_factorial_table<int64_t>(20);
+	test_factorial_table<uint64_t>(20);
+#if defined(__SIZEOF_INT128__)
+	test_factorial_table<concurrent_permcomb::uint128_type>(34);
+#endif
+	test_factorial_table<int_type>(5);
+	test_factorial_table<int_type>(20);
+	if (!concurrent_permcomb::int_limits<int_type>::is_bounded)
+		test_factorial_table<int_type>(40); // past the tables
+}
+
+void unit_test_threaded_fixed()
+{
+	int_type thread_cnt = 4;
+	test_threaded_perm_fixed<int_type, 3>(int_type(1), int_type(1));
+	test_threaded_perm_fixed<int_type, 3>(int_type(1), int_type(4));
+	test_threaded_perm_fixed<int_type, 4>(int_type(1), thread_cnt);
+	test_threaded_perm_fixed<int_type, 5>(int_type(2), thread_cnt);
+	test_threaded_perm_fixed<int_type, 7>(int_type(3), thread_cnt);
+	test_threaded_perm_fixed<int_type, 8>(int_type(1), int_type(7));
+	test_threaded_perm_fixed<int_type, 9>(int_type(2), thread_cnt);
+	test_threaded_perm_fixed<int_type, 2>(int_type(1), int_type(2)); // falls back to compute_all_perm
+	test_find_perm_fixed<3>(6);
+	test_find_perm_fixed<12>(1000);
+	test_find_perm_fixed<20>(1000);
+
+	typedef concurrent_permcomb::int_limits<int_type> limits;
+	if (!limits::is_bounded || limits::digits > 64)
+	{
+		test_perm_fixed_fallback<int_type, 21>(1000);
+	}
+}
+
+void benchmark_find_perm()
+{
+	std::string original_text = "ABCDEFGHIJKLMNOPQRST";
+	int_type factorial = 0;
+	concurrent_perm::compute_factorial(original_text.size(), factorial);
+
+	const concurrent_perm::factorial_table<int_type> factorials(original_text.size());
+	size_t checksum = 0;
+	timer stopwatch;
+	stopwatch.start("find_perm_by_idx");
+	for (int_type i = 0; i < 1000000; ++i)
+	{
+		int_type index_to_find = (factorial / 1000000) * i;
+		std::string permuted = concurrent_perm::find_perm_by_idx(factorials, index_to_find, original_text);
+		checksum += permuted[0];
+	}
+	stopwatch.stop();
+	std::cout << "checksum: " << checksum << std::endl;
+}
+
 void usage_of_next_perm()
 {
 	std::string std_permuted = "12345";
@@ -1,7 +1,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 // combination.h header file
 //
-// Combination version 1.5
+// Combination version 1.6
 // Copyright 2007 Wong Shao Voon
 // Distributed under the Boost Software License, Version 1.0. (See
 // accompanying file LICENSE_1_0.txt or copy at
@@ -81,7 +81,9 @@ std::reverse_iterator<Iterator> make_reverse_iterator(Iterator i)
 {
     return std::reverse_iterator<Iterator>(i);
 }
-// experimental
+// Like next_combination, but the combination is a sequence of iterators
+// into [n_begin, n_end) in increasing order, so elements are never compared
+// or copied. Returns false after the last combination.
 template <class BidIt, class BidItIt>
 inline bool next_combination_with_state(BidIt n_begin, BidIt n_end,
 	BidItIt r_beginIT, BidItIt r_endIT)
@@ -101,15 +103,12 @@ inline bool next_combination_with_state(BidIt n_begin, BidIt n_end,
 
 		if (r_it1 == n_it1)
 		{
-			if (it != rend) //to ensure not at the start of r sequence
-			{
-				boolmarked = true;
-				r_marked = ++it;
-				--it;//add it back again 
-				continue;
-			}
-			else // it means it is at the start the sequence, so return false
-				return false;
+			r_marked = it;
+			++r_marked;
+			if (r_marked == rend) // at the start of the r sequence, so this was the last combination
+				return false; // before --n_it1 could step past n_begin
+			boolmarked = true;
+			continue;
 		}
 		else //if(r_it1!=n_it1 )
 		{
@@ -131,7 +130,7 @@ inline bool next_combination_with_state(BidIt n_begin, BidIt n_end,
 		}
 	}
 
-	return false; // will reach here at the last combination
+	return false; // will reach here only for an empty r sequence
 }
 
 
@@ -10,10 +10,27 @@
 //
 // version 0.1.0: Initial Release
 // version 0.1.1: More error handling when result count < cpu count
+// version 0.2.0: Added compute_all_comb_chunked for chunked work stealing
+// version 0.3.0: compute_all_comb overloads taking a reusable thread_pool
+// version 0.4.0: Added compute_all_comb_batched to deliver blocks of combinations
+// version 0.5.0: compute_all_comb overloads taking a cancel_token
+// version 0.6.0: Added compute_all_comb_idx to advance indices instead of elements
+// version 0.7.0: Added compute_all_comb_state using next_combination_with_state
+// version 0.8.0: Added compute_all_comb_mask for fullsets of up to 64 elements
+// version 0.9.0: Added compute_all_comb_revdoor for revolving door order
+// version 0.10.0: find_comb unranks from a shared binomial_table
+// version 0.11.0: Added rank_comb, rank_comb_by_elem and rank_comb_bulk
+// version 0.12.0: Added compute_all_multichoose for combinations with repetition
+// version 0.13.0: Added compute_all_subsets to split the power set in one run
+// version 0.14.0: Added compute_all_multiset_comb for elements with duplicates
+// version 0.15.0: Added compute_all_comb_pruned to skip combinations by prefix
+// version 0.16.0: compute_total_comb no longer overflows before the total does, added compute_all_comb_native
+// version 0.17.0: Slices past int64_t are counted on uint64_t sub-ranges
+// version 0.18.0: Works with unsigned __int128 as int_type
+// version 0.19.0: Factorials and binomials come from compile-time tables for native int_type
 
 #pragma once
 
-#include <list>
 #include <vector>
 #include <iterator>
 #include <memory>
@@ -23,7 +40,9 @@
 #include <numeric> // for iota
 #include <cstdint>
 #include <sstream>
+#include <limits>
 #include "combination.h"
+#include "concurrent_common.h"
 
 namespace concurrent_comb
 {
@@ -35,6 +54,9 @@ struct no_predicate_type
 template<typename int_type>
 void compute_factorial( uint32_t num, int_type& factorial )
 {
+	if (concurrent_permcomb::native_tables<int_type>::factorial(num, factorial))
+		return;
+
 	factorial = 1;
 
 	for( uint32_t i=2; i<=num; ++i )
@@ -44,50 +66,145 @@ void compute_factorial( uint32_t num, int_type& factorial )
 }
 
 template<typename int_type>
-void find_range( const uint32_t &Min, const uint32_t &Max, int_type& result )
+int_type compute_gcd( int_type a, int_type b )
 {
-	if(Min == Max)
-	{
-		result = 1;
-		return;
-	}
-
-	result = Min+1;
-
-	for( int_type i=Min+2; i<=Max; ++i )
+	while( b != 0 )
 	{
-		result = result * i;
+		int_type r = a % b;
+		a = b;
+		b = r;
 	}
+	return a;
 }
 
+// C(fullset, subset) worked out one factor at a time: after step i, total
+// is C(fullset - subset + i, i), so the running value never goes above the
+// answer. Each step divides out the gcd before multiplying, which keeps the
+// product itself in range too. Returns false when subset > fullset or when
+// the answer does not fit in int_type.
 template<typename int_type>
 bool compute_total_comb( const uint32_t fullset, const uint32_t subset, int_type& total )
 {
 	if (subset > fullset)
 		return false;
 
-	if( subset == fullset )
-	{
-		total = 1;
+	if (concurrent_permcomb::native_tables<int_type>::binomial(fullset, subset, total))
 		return true;
+
+	const uint32_t acomb = fullset - subset;
+	const uint32_t steps = (acomb < subset) ? acomb : subset;
+	const uint32_t base = fullset - steps;
+
+	int_type result = 1;
+	for( uint32_t i=1; i<=steps; ++i )
+	{
+		if (concurrent_permcomb::int_limits<int_type>::digits < 32 && base + i > static_cast<uint32_t>(concurrent_permcomb::int_limits<int_type>::max()))
+			return false;
+		// result * (base + i) / i is exact; split i between the two factors
+		const int_type divisor = static_cast<int_type>(i);
+		const int_type g = compute_gcd(result, divisor);
+		result /= g;
+		const int_type factor = static_cast<int_type>(base + i) / (divisor / g);
+		if (concurrent_permcomb::int_limits<int_type>::is_bounded && result > concurrent_permcomb::int_limits<int_type>::max() / factor)
+			return false;
+		result *= factor;
 	}
+	total = result;
+
+	return true;
+}
 
-	uint32_t acomb = fullset - subset;
+// Pascal's triangle holding C(j + d, j) for j <= subset and d <= fullset - subset,
+// which is every binomial find_comb looks up. It is built with additions only,
+// so no entry is larger than C(fullset, subset). Build it once and share it
+// read-only between threads and lookups. For a native int_type whose
+// compile-time table reaches fullset, nothing is built and get() reads that.
+template<typename int_type>
+class binomial_table
+{
+public:
+	binomial_table(uint32_t fullset, uint32_t subset)
+		: m_fullset(fullset)
+		, m_subset(subset)
+		, m_width(subset <= fullset ? fullset - subset + 1 : 0)
+		, m_pascal(nullptr)
+	{
+		typedef concurrent_permcomb::native_tables<int_type> native;
+		if (native::available && subset <= fullset && fullset <= native::max_binomial)
+		{
+			m_pascal = native::pascal();
+			return;
+		}
 
-	int_type factorial = 0;
-	int_type range = 0;
-	if( acomb >= subset )
+		m_table.assign(static_cast<size_t>(subset + 1) * m_width, int_type(1));
+		for (uint32_t j = 1; j <= m_subset; ++j)
+		{
+			for (uint32_t d = 1; d < m_width; ++d)
+			{
+				m_table[j * m_width + d] = m_table[(j - 1) * m_width + d] + m_table[j * m_width + d - 1];
+			}
+		}
+	}
+	uint32_t fullset() const
 	{
-		compute_factorial(subset, factorial );
-		find_range( acomb, fullset, range );
+		return m_fullset;
 	}
-	else
+	uint32_t subset() const
+	{
+		return m_subset;
+	}
+	bool valid() const
+	{
+		return m_width > 0;
+	}
+	// C(fullset, subset)
+	const int_type& total() const
+	{
+		return get(m_fullset, m_subset);
+	}
+	// C(n, k) where k <= subset and k <= n <= k + fullset - subset
+	const int_type& get(uint32_t n, uint32_t k) const
 	{
-		compute_factorial( acomb, factorial );
-		find_range( subset, fullset, range );
+		if (concurrent_permcomb::native_tables<int_type>::available && m_pascal)
+			return m_pascal[n * (n + 1) / 2 + k];
+		return m_table[k * m_width + (n - k)];
 	}
-	total = range / factorial;
 
+private:
+	uint32_t m_fullset;
+	uint32_t m_subset;
+	uint32_t m_width;
+	const int_type* m_pascal; // compile-time triangle, C(n, k) at n * (n + 1) / 2 + k
+	std::vector<int_type> m_table;
+};
+
+// Finds the combination at index_to_find in lexicographic order with table
+// lookups and subtractions only. results is resized to table.subset().
+template<typename int_type>
+bool find_comb(const binomial_table<int_type>& table, 
+			   int_type index_to_find,
+			   std::vector<uint32_t>& results )
+{
+	const uint32_t fullset = table.fullset();
+	const uint32_t subset = table.subset();
+	if( !table.valid() || subset == 0 || index_to_find >= table.total() )
+		return false;
+
+	results.resize(subset);
+	uint32_t elem = 0;
+	for( uint32_t x=0; x<subset; ++x )
+	{
+		// skip every combination which takes elem at position x
+		for (;;)
+		{
+			const int_type& cnt = table.get(fullset - 1 - elem, subset - 1 - x);
+			if (index_to_find < cnt)
+				break;
+			index_to_find -= cnt;
+			++elem;
+		}
+		results[x] = elem++;
+	}
 	return true;
 }
 
@@ -95,26 +212,24 @@ template<typename int_type>
 bool find_comb(const uint32_t fullset, 
 			   const uint32_t subset, 
 			   int_type index_to_find,
-			   std::vector<uint32_t>& results );
+			   std::vector<uint32_t>& results )
+{
+	if( subset > fullset || fullset == 0 || subset == 0 )
+		return false;
+
+	const binomial_table<int_type> table(fullset, subset);
+	return find_comb(table, index_to_find, results);
+}
 
 template<typename int_type, typename vector_type>
-vector_type find_comb_by_idx(const uint32_t subset,
+vector_type find_comb_by_idx(const binomial_table<int_type>& table,
 	int_type index_to_find,
 	vector_type& original_vector)
 {
-	int_type total = 0;
-	if (compute_total_comb(original_vector.size(), subset, total))
-	{
-		if (index_to_find >= total)
-			return {};
-	}
-
-	std::vector<uint32_t> integer_results(subset);
-	std::iota(integer_results.begin(), integer_results.end(), 0);
+	std::vector<uint32_t> integer_results;
 
 	vector_type results;
-	if (find_comb(original_vector.size(),
-		subset,
+	if (original_vector.size() == table.fullset() && find_comb(table,
 		index_to_find,
 		integer_results))
 	{
@@ -127,23 +242,26 @@ vector_type find_comb_by_idx(const uint32_t subset,
 }
 
 template<typename int_type, typename vector_type>
-typename std::vector<typename vector_type::iterator> find_comb_state_by_idx(const uint32_t subset,
+vector_type find_comb_by_idx(const uint32_t subset,
 	int_type index_to_find,
 	vector_type& original_vector)
 {
-	int_type total = 0;
-	if (compute_total_comb(original_vector.size(), subset, total))
-	{
-		if (index_to_find >= total)
-			return {};
-	}
+	if (subset > original_vector.size())
+		return {};
 
-	std::vector<uint32_t> integer_results(subset);
-	std::iota(integer_results.begin(), integer_results.end(), 0);
+	const binomial_table<int_type> table(original_vector.size(), subset);
+	return find_comb_by_idx(table, index_to_find, original_vector);
+}
+
+template<typename int_type, typename vector_type>
+typename std::vector<typename vector_type::iterator> find_comb_state_by_idx(const binomial_table<int_type>& table,
+	int_type index_to_find,
+	vector_type& original_vector)
+{
+	std::vector<uint32_t> integer_results;
 
 	typename std::vector<typename vector_type::iterator> results;
-	if (find_comb(original_vector.size(),
-		subset,
+	if (original_vector.size() == table.fullset() && find_comb(table,
 		index_to_find,
 		integer_results))
 	{
@@ -155,88 +273,142 @@ typename std::vector<typename vector_type::iterator> find_comb_state_by_idx(cons
 	return results;
 }
 
+template<typename int_type, typename vector_type>
+typename std::vector<typename vector_type::iterator> find_comb_state_by_idx(const uint32_t subset,
+	int_type index_to_find,
+	vector_type& original_vector)
+{
+	if (subset > original_vector.size())
+		return {};
+
+	const binomial_table<int_type> table(original_vector.size(), subset);
+	return find_comb_state_by_idx(table, index_to_find, original_vector);
+}
+
+// Inverse of find_comb: the lexicographic rank of strictly increasing
+// indices into [0, fullset), which is
+// C(fullset, subset) - 1 - sum of C(fullset - 1 - indices[i], subset - i)
+// so it costs subset table lookups.
 template<typename int_type>
-bool find_comb(const uint32_t fullset, 
-			   const uint32_t subset, 
-			   int_type index_to_find,
-			   std::vector<uint32_t>& results )
+bool rank_comb(const binomial_table<int_type>& table, 
+			   const std::vector<uint32_t>& indices,
+			   int_type& rank )
 {
-	if( subset > fullset || fullset == 0 || subset == 0 )
+	const uint32_t fullset = table.fullset();
+	const uint32_t subset = table.subset();
+	if( !table.valid() || subset == 0 || indices.size() != subset )
 		return false;
 
-	// Actual Processing
-	uint32_t remaining_set = fullset - 1;  
-	uint32_t remaining_comb = subset - 1;  
-
-	for( uint32_t x=0; x<subset; ++x )
+	int_type tail = 0;
+	for( uint32_t i=0; i<subset; ++i )
 	{
+		if( indices[i] >= fullset || (i > 0 && indices[i] <= indices[i-1]) )
+			return false;
 
-		if( x == subset-1 ) // Last Element
-		{
-			while( true )
-			{
-				if( 0 == index_to_find )
-				{
-					results[x] = fullset - remaining_set - 1;
-					break;			
-				}
-				else
-				{
-					index_to_find -= 1;
-					--remaining_set;
-				}
-			}
-		}
-		else
-		{
-			int_type total_comb=0;
-			int_type prev=0;
+		const uint32_t remaining_set = fullset - 1 - indices[i];
+		if( remaining_set >= subset - i )
+			tail += table.get(remaining_set, subset - i);
+	}
+	rank = table.total() - 1 - tail;
+	return true;
+}
 
-			uint32_t loop = remaining_set-remaining_comb;
-			bool found = false;
-			uint32_t x_prev = 0;
+template<typename int_type>
+bool rank_comb(const uint32_t fullset, 
+			   const std::vector<uint32_t>& indices,
+			   int_type& rank )
+{
+	const uint32_t subset = static_cast<uint32_t>(indices.size());
+	if( subset > fullset || subset == 0 )
+		return false;
 
-			if( x > 0 )
-				x_prev = results[ x-1 ] + 1;
+	const binomial_table<int_type> table(fullset, subset);
+	return rank_comb(table, indices, rank);
+}
 
-			uint32_t y;
-			for( y=0; y<loop; ++y )
-			{
-				if (!compute_total_comb(remaining_set, remaining_comb, total_comb))
-					return false;
+// Inverse of find_comb_by_idx. The elements of comb are matched in order
+// against original_vector with ==, like next_combination does.
+template<typename int_type, typename vector_type>
+bool rank_comb_by_elem(const binomial_table<int_type>& table,
+	const vector_type& original_vector,
+	const vector_type& comb,
+	int_type& rank)
+{
+	if (original_vector.size() != table.fullset())
+		return false;
 
-				total_comb += prev;
-				if( total_comb > index_to_find ) // prev is the found one
-				{
-					index_to_find -= prev;
+	std::vector<uint32_t> integer_comb;
+	integer_comb.reserve(comb.size());
+	uint32_t pos = 0;
+	for (auto it = comb.begin(); it != comb.end(); ++it)
+	{
+		while (pos < original_vector.size() && !(original_vector[pos] == *it))
+			++pos;
+		if (pos == original_vector.size())
+			return false;
+		integer_comb.push_back(pos++);
+	}
+	return rank_comb(table, integer_comb, rank);
+}
 
-					results[x] = y + x_prev;
+// Ranks every combination of combs, each of subset elements, on thread_cnt
+// threads. ranks[i] is set to C(fullset, subset), one past the last rank,
+// for an entry which is not a combination of original_vector, in which case
+// false is returned.
+template<typename int_type, typename vector_type>
+bool rank_comb_bulk(int_type thread_cnt,
+	const uint32_t subset,
+	const vector_type& original_vector,
+	const std::vector<vector_type>& combs,
+	std::vector<int_type>& ranks)
+{
+	ranks.assign(combs.size(), int_type(0));
+	if (thread_cnt <= 0 || subset == 0 || subset > original_vector.size())
+		return false;
+	if (combs.empty())
+		return true;
 
-					found = true;
-					break;
-				}
-				prev = total_comb;
-				--remaining_set;
-			}
+	const binomial_table<int_type> table(static_cast<uint32_t>(original_vector.size()), subset);
+	const int_type comb_cnt = static_cast<int_type>(combs.size());
+	if (comb_cnt < thread_cnt)
+	{
+		thread_cnt = comb_cnt;
+	}
 
-			if( !found )
+	std::atomic<bool> all_ranked(true);
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, int_type(0), comb_cnt,
+		[&](const int_type& thread_index, const int_type& start_index, const int_type& end_index)
+	{
+		const size_t end_i = static_cast<size_t>(end_index);
+		for (size_t i = static_cast<size_t>(start_index); i < end_i; ++i)
+		{
+			if (!rank_comb_by_elem(table, original_vector, combs[i], ranks[i]))
 			{
-				index_to_find -= total_comb;
-
-				results[x] = y + x_prev;
-
+				ranks[i] = table.total();
+				all_ranked.store(false);
 			}
-
-			--remaining_set;
-			--remaining_comb;
 		}
-	}
+	});
+	return all_ranked.load();
+}
 
-	return true;
-};
+template<typename container_type, typename predicate_type>
+typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+next_comb(container_type& cont_full_set, container_type& cont, predicate_type pred)
+{
+	return stdcomb::next_combination(cont_full_set.begin(), cont_full_set.end(), cont.begin(), cont.end(), pred);
+}
+
+template<typename container_type, typename predicate_type>
+typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+next_comb(container_type& cont_full_set, container_type& cont, predicate_type)
+{
+	return stdcomb::next_combination(cont_full_set.begin(), cont_full_set.end(), cont.begin(), cont.end());
+}
 
 template<typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
-typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value>::type 
+typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value, bool>::type 
 comb_loop(const int thread_index, container_type& cont_full_set, container_type& cont, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback, predicate_type pred)
 {
     index_type j = start;
@@ -245,32 +417,34 @@ comb_loop(const int thread_index, container_type& cont_full_set, container_type&
         for (; j < end; ++j)
         {
             if (!callback(thread_index, cont_full_set.size(), cont))
-                return;
+                return false;
             stdcomb::next_combination(cont_full_set.begin(), cont_full_set.end(), cont.begin(), cont.end(), pred);
         }
+        return true;
     }
     catch(std::exception& ex)
     {
         std::ostringstream oss;
         oss << "Exception thrown thrown in comb_loop:" << ex.what();
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont_full_set.size(), cont, oss.str());
     }
     catch(...)
     {
         std::ostringstream oss;
         oss << "Unknown exception thrown in comb_loop:";
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont_full_set.size(), cont, oss.str());
     }
+    return false;
 }
 
 template<typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
-typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value>::type 
+typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value, bool>::type 
 comb_loop(const int thread_index, container_type& cont_full_set, container_type& cont, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback, predicate_type pred)
 {
     index_type j = start;
@@ -279,181 +453,264 @@ comb_loop(const int thread_index, container_type& cont_full_set, container_type&
         for (; j < end; ++j)
         {
             if (!callback(thread_index, cont_full_set.size(), cont))
-                return;
+                return false;
             stdcomb::next_combination(cont_full_set.begin(), cont_full_set.end(), cont.begin(), cont.end());
         }
+        return true;
     }
     catch(std::exception& ex)
     {
         std::ostringstream oss;
         oss << "Exception thrown thrown in comb_loop:" << ex.what();
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont_full_set.size(), cont, oss.str());
     }
     catch(...)
     {
         std::ostringstream oss;
         oss << "Unknown exception thrown in comb_loop:";
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont_full_set.size(), cont, oss.str());
     }
+    return false;
+}
+
+// Fill vec with the subset elements of the combination at start_index
+template<typename int_type, typename container_type>
+void make_start_comb(const container_type& cont, const binomial_table<int_type>& table, const int_type& start_index, container_type& vec)
+{
+	std::vector<uint32_t> results(table.subset());
+	std::iota(results.begin(), results.end(), 0);
+
+	if(start_index>0)
+	{
+		find_comb(table, start_index, results);
+	}
+	for(size_t i=0; i<results.size(); ++i)
+	{
+		vec.push_back(cont[results[i]]);
+	}
 }
 
 template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
-void worker_thread_proc(const int_type thread_index, 
+bool worker_thread_proc(const int_type thread_index, 
 						const container_type& cont,
 						int_type start_index, 
 						int_type end_index, 
-						uint32_t subset, 
+						const binomial_table<int_type>& table, 
 						callback_type callback,
                         error_callback_type err_callback,
 						predicate_type pred)
 {
 	const int thread_index_n = static_cast<const int>(thread_index);
 
-	std::vector<uint32_t> results(subset);
-	std::iota(results.begin(), results.end(), 0);
-
-	if(start_index>0)
-	{
-		find_comb(cont.size(), subset, start_index, results);
-	}
 	container_type vec;
-	for(size_t i=0; i<results.size(); ++i)
-	{
-		vec.push_back(cont[results[i]]);
-	}
+	make_start_comb(cont, table, start_index, vec);
 	container_type cont_fullset(cont.begin(), cont.end());
 	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
 	{ 
 		const int start_i = static_cast<int>(start_index);
 		const int end_i = static_cast<int>(end_index);
 
-		comb_loop(thread_index_n, cont_fullset, vec, start_i, end_i, callback, err_callback, pred);
+		return comb_loop(thread_index_n, cont_fullset, vec, start_i, end_i, callback, err_callback, pred);
 	}
 	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
 	{
 		const int64_t start_i = static_cast<int64_t>(start_index);
 		const int64_t end_i = static_cast<int64_t>(end_index);
-		comb_loop(thread_index_n, cont_fullset, vec, start_i, end_i, callback, err_callback, pred);
+		return comb_loop(thread_index_n, cont_fullset, vec, start_i, end_i, callback, err_callback, pred);
 	}
 	else
 	{
-		comb_loop(thread_index_n, cont_fullset, vec, start_index, end_index, callback, err_callback, pred);
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return comb_loop(thread_index_n, cont_fullset, vec, uint64_t(0), cnt, callback, err_callback, pred);
+		});
 	}
 }
 
-template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
-bool compute_all_comb_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+// Copies up to block_size consecutive combinations into one flat buffer,
+// subset elements each, and hands the whole block to callback. The rank of
+// the combination at counter j is base + j; base is only added for callback.
+template<typename int_type, typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool comb_batched_loop(const int thread_index, container_type& cont_full_set, container_type& cont, const int_type& base, const index_type& start, const index_type& end, uint32_t block_size, callback_type callback, error_callback_type err_callback, predicate_type pred)
 {
-	if (cpu_cnt <= 0)
-	{
-		std::ostringstream oss;
-		oss << "Error: cpu_cnt(" << cpu_cnt;
-		oss << ") <= 0";
+    typedef typename container_type::value_type value_type;
+    const uint32_t subset = static_cast<uint32_t>(cont.size());
+    std::vector<value_type> block(static_cast<size_t>(subset) * block_size);
+    index_type j = start;
+    try
+    {
+        while (j < end)
+        {
+            const index_type block_start = j;
+            size_t block_cnt = 0;
+            value_type* dest = block.data();
+            for (; j < end && block_cnt < block_size; ++j, ++block_cnt)
+            {
+                dest = std::copy(cont.begin(), cont.end(), dest);
+                next_comb(cont_full_set, cont, pred);
+            }
+            const value_type* block_data = block.data();
+            if (!callback(thread_index, cont_full_set.size(), block_data, block_cnt, subset, base + static_cast<int_type>(block_start)))
+                return false;
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in comb_batched_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont_full_set.size(), cont, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in comb_batched_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont_full_set.size(), cont, oss.str());
+    }
+    return false;
+}
 
-		err_callback(int_type(0), cont.size(), cont, oss.str());
-		return false;
-	}
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool batched_worker_thread_proc(const int_type thread_index, 
+						const container_type& cont,
+						int_type start_index, 
+						int_type end_index, 
+						const binomial_table<int_type>& table, 
+						uint32_t block_size,
+						callback_type callback,
+						error_callback_type err_callback,
+						predicate_type pred)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
 
-	if (thread_cnt <= 0)
+	container_type vec;
+	make_start_comb(cont, table, start_index, vec);
+	container_type cont_fullset(cont.begin(), cont.end());
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return comb_batched_loop(thread_index_n, cont_fullset, vec, int_type(0), start_i, end_i, block_size, callback, err_callback, pred);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
 	{
-		std::ostringstream oss;
-		oss << "Error: thread_cnt(" << thread_cnt;
-		oss << ") <= 0";
-
-		err_callback(int_type(0), cont.size(), cont, oss.str());
-		return false;
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return comb_batched_loop(thread_index_n, cont_fullset, vec, int_type(0), start_i, end_i, block_size, callback, err_callback, pred);
 	}
-
-	if (subset <= 0)
+	else
 	{
-		std::ostringstream oss;
-		oss << "Error: subset(" << subset;
-		oss << ") <= 0";
+		return concurrent_permcomb::run_native_sub_ranges_skipping(start_index, end_index, [&](const int_type& sub_start, uint64_t cnt, int_type&) -> bool
+		{
+			return comb_batched_loop(thread_index_n, cont_fullset, vec, sub_start, uint64_t(0), cnt, block_size, callback, err_callback, pred);
+		});
+	}
+}
 
-		err_callback(int_type(0), cont.size(), cont, oss.str());
+template<typename int_type, typename container_type, typename error_callback_type>
+bool split_comb_range(const int_type& cpu_index, const int_type& cpu_cnt, int_type& thread_cnt, uint32_t subset,
+	const container_type& cont, error_callback_type err_callback, int_type& offset, int_type& each_cpu_elem_cnt)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error) ||
+		!concurrent_permcomb::check_positive("subset", subset, error))
+	{
+		err_callback(0, cont.size(), cont, error);
 		return false;
 	}
 
 	int_type total_comb=0; 
 	if (!compute_total_comb(cont.size(), subset, total_comb))
 	{
-		err_callback(int_type(0), cont.size(), cont, "Error: compute_total_comb() return false");
+		err_callback(0, cont.size(), cont, "Error: compute_total_comb() return false");
 		return false;
 	}
 
-	if (total_comb < cpu_cnt)
+	if (!concurrent_permcomb::split_cpu_range(total_comb, "total_comb", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
 	{
-		std::ostringstream oss;
-		oss << "Error: total_comb(" << total_comb;
-		oss << ") < cpu_cnt(" << cpu_cnt << ")";
-
-		err_callback(int_type(0), cont.size(), cont, oss.str());
+		err_callback(0, cont.size(), cont, error);
 		return false;
 	}
+	return true;
+}
 
-	int_type each_cpu_elem_cnt = total_comb / cpu_cnt;
-	int_type cpu_remainder = total_comb % cpu_cnt;
-	int_type offset = cpu_index*each_cpu_elem_cnt;
-	if (cpu_index == (cpu_cnt - 1) && cpu_remainder > 0)
-	{
-		each_cpu_elem_cnt += cpu_remainder;
-	}
+template<typename launcher_type, typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool run_comb_shard(launcher_type& launcher, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_comb_range(cpu_index, cpu_cnt, thread_cnt, subset, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
 
-	if (each_cpu_elem_cnt <= 0)
+	const binomial_table<int_type> table(cont.size(), subset);
+
+	concurrent_permcomb::run_thread_slices(launcher, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
 	{
-		std::ostringstream oss;
-		oss << "Error: each_cpu_elem_cnt(" << each_cpu_elem_cnt;
-		oss << ") <= 0";
+		return worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, start_index, end_index, table, callback, err_callback, pred);
+	});
 
-		err_callback(int_type(0), cont.size(), cont, oss.str());
-		return false;
-	}
+	return true;
+}
 
-	if (each_cpu_elem_cnt < thread_cnt)
+template<typename launcher_type, typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool run_comb_chunked_shard(launcher_type& launcher, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, int_type chunk_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("chunk_cnt", chunk_cnt, error))
 	{
-		thread_cnt = 1;
+		err_callback(0, cont.size(), cont, error);
+		return false;
 	}
 
-	int_type each_thread_elem_cnt = each_cpu_elem_cnt / thread_cnt;
-	int_type remainder = each_cpu_elem_cnt % thread_cnt;
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_comb_range(cpu_index, cpu_cnt, thread_cnt, subset, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
 
-	std::vector<std::shared_ptr<std::thread> > threads;
+	const binomial_table<int_type> table(cont.size(), subset);
 
-	int_type bulk = each_thread_elem_cnt;
-	for(int_type i=1; i<thread_cnt; ++i)
+	concurrent_permcomb::run_thread_chunks(launcher, thread_cnt, chunk_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
 	{
-		// test for last thread
-		bulk = each_thread_elem_cnt;
-		if( i == (thread_cnt-1) && remainder > 0 )
-		{
-			bulk += remainder;
-		}
-		int_type start_index = i * each_thread_elem_cnt + offset;
-		int_type end_index = start_index + bulk;
-		threads.push_back( std::shared_ptr<std::thread>(new std::thread(
-			std::bind(worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>, i, cont, start_index, end_index, subset, callback, err_callback, pred))));
-	}
+		return worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, start_index, end_index, table, callback, err_callback, pred);
+	});
 
-	bulk = each_thread_elem_cnt; // reset remainder
-	int_type start_index = offset;
-	int_type end_index = start_index + bulk;
-	int_type thread_index=0;
-	worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>( thread_index, cont, start_index, end_index, subset, callback, err_callback, pred);
+	return true;
+}
 
-	for(size_t i=0; i<threads.size(); ++i)
+template<typename int_type, typename container_type, typename error_callback_type>
+bool check_pool(const concurrent_permcomb::thread_pool& pool, const int_type& thread_cnt, const container_type& cont, error_callback_type err_callback)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_pool_thread_cnt(pool, thread_cnt, error))
 	{
-		threads[i]->join();
+		err_callback(0, cont.size(), cont, error);
+		return false;
 	}
-
 	return true;
 }
 
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	concurrent_permcomb::thread_spawner spawner;
+	return run_comb_shard(spawner, cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback, pred);
+}
+
 template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
 bool compute_all_comb(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
 {
@@ -462,4 +719,1891 @@ bool compute_all_comb(int_type thread_cnt, uint32_t subset, const container_type
 	return compute_all_comb_shard(cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback, pred);
 }
 
-}
\ No newline at end of file
+// Runs compute_all_comb on the narrowest of int32_t, int64_t and, where the
+// compiler has it, __int128 which holds the total, so a job never pays for a
+// Boost Multiprecision type it does not need. Reports an error when the
+// total is too big for all of them.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_native(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int32_t total32 = 0;
+	if (compute_total_comb(cont.size(), subset, total32))
+		return compute_all_comb(static_cast<int32_t>(thread_cnt), subset, cont, callback, err_callback, pred);
+
+	// subset > cont.size() is reported by compute_all_comb
+	int64_t total64 = 0;
+	if (subset > cont.size() || compute_total_comb(cont.size(), subset, total64))
+		return compute_all_comb(static_cast<int64_t>(thread_cnt), subset, cont, callback, err_callback, pred);
+
+	std::ostringstream oss;
+#if defined(__SIZEOF_INT128__)
+	concurrent_permcomb::int128_type total128 = 0;
+	if (compute_total_comb(cont.size(), subset, total128))
+		return compute_all_comb(static_cast<concurrent_permcomb::int128_type>(static_cast<int64_t>(thread_cnt)), subset, cont, callback, err_callback, pred);
+	oss << "Error: total_comb of C(" << cont.size() << ", " << subset << ") does not fit in __int128";
+#else
+	oss << "Error: total_comb of C(" << cont.size() << ", " << subset << ") does not fit in int64_t";
+#endif
+	err_callback(0, cont.size(), cont, oss.str());
+	return false;
+}
+
+// Runs on the parked threads of pool instead of spawning new ones.
+// thread_cnt must not exceed pool.thread_cnt().
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_shard(concurrent_permcomb::thread_pool& pool, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	if (!check_pool(pool, thread_cnt, cont, err_callback))
+		return false;
+
+	return run_comb_shard(pool, cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback, pred);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb(concurrent_permcomb::thread_pool& pool, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_shard(pool, cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback, pred);
+}
+
+// Stops every thread promptly once token is tripped, either by another
+// thread calling token.cancel() or by callback returning false. Returns
+// run_status::failed if err_callback was called, run_status::cancelled if
+// token was tripped, otherwise run_status::completed.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+concurrent_permcomb::run_status compute_all_comb_shard(concurrent_permcomb::cancel_token& token, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	std::atomic<bool> failed(false);
+	concurrent_permcomb::thread_spawner spawner;
+	run_comb_shard(spawner, cpu_index, cpu_cnt, thread_cnt, subset, cont,
+		concurrent_permcomb::make_cancellable_callback(callback, token),
+		concurrent_permcomb::make_cancelling_err_callback(err_callback, token, failed), pred);
+
+	return concurrent_permcomb::get_run_status(token, failed);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+concurrent_permcomb::run_status compute_all_comb(concurrent_permcomb::cancel_token& token, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_shard(token, cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback, pred);
+}
+
+// Same split across cpus as compute_all_comb_shard, but the cpu's share is cut
+// into chunk_cnt chunks which threads keep claiming until none is left.
+// Returning false from callback stops the current thread from claiming more chunks.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_chunked_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, int_type chunk_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	concurrent_permcomb::thread_spawner spawner;
+	return run_comb_chunked_shard(spawner, cpu_index, cpu_cnt, thread_cnt, chunk_cnt, subset, cont, callback, err_callback, pred);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_chunked(int_type thread_cnt, int_type chunk_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_chunked_shard(cpu_index, cpu_cnt, thread_cnt, chunk_cnt, subset, cont, callback, err_callback, pred);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_chunked_shard(concurrent_permcomb::thread_pool& pool, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, int_type chunk_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	if (!check_pool(pool, thread_cnt, cont, err_callback))
+		return false;
+
+	return run_comb_chunked_shard(pool, cpu_index, cpu_cnt, thread_cnt, chunk_cnt, subset, cont, callback, err_callback, pred);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_chunked(concurrent_permcomb::thread_pool& pool, int_type thread_cnt, int_type chunk_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_chunked_shard(pool, cpu_index, cpu_cnt, thread_cnt, chunk_cnt, subset, cont, callback, err_callback, pred);
+}
+
+// Advances indices, a strictly increasing selection out of [0, fullset), to
+// the next combination in lexicographic order. Only the tail after the
+// rightmost index that can still grow is rewritten, so this is O(1)
+// amortized. Returns false after the last combination.
+inline bool next_comb_idx(std::vector<uint32_t>& indices, uint32_t fullset)
+{
+	const uint32_t subset = static_cast<uint32_t>(indices.size());
+	uint32_t i = subset;
+	while (i > 0 && indices[i - 1] == fullset - subset + i - 1)
+		--i;
+	if (i == 0)
+		return false;
+
+	uint32_t value = ++indices[i - 1];
+	for (; i < subset; ++i)
+	{
+		indices[i] = ++value;
+	}
+	return true;
+}
+
+// Copy of the combination an index_view stands for, for error reporting
+template<typename container_type>
+container_type view_to_container(const container_type& cont, const std::vector<uint32_t>& indices)
+{
+	container_type vec;
+	for(size_t i=0; i<indices.size(); ++i)
+	{
+		vec.push_back(cont[indices[i]]);
+	}
+	return vec;
+}
+
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool comb_idx_loop(const int thread_index, const container_type& cont, std::vector<uint32_t>& indices, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    const uint32_t fullset = static_cast<uint32_t>(cont.size());
+    const concurrent_permcomb::index_view<container_type, uint32_t> view(cont, indices.data(), indices.size());
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, cont.size(), view))
+                return false;
+            next_comb_idx(indices, fullset);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in comb_idx_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in comb_idx_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool idx_worker_thread_proc(const int_type thread_index, 
+						const container_type& cont,
+						int_type start_index, 
+						int_type end_index, 
+						const binomial_table<int_type>& table, 
+						callback_type callback,
+						error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+
+	std::vector<uint32_t> indices(table.subset());
+	std::iota(indices.begin(), indices.end(), 0);
+	if(start_index>0)
+	{
+		find_comb(table, start_index, indices);
+	}
+
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return comb_idx_loop(thread_index_n, cont, indices, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return comb_idx_loop(thread_index_n, cont, indices, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return comb_idx_loop(thread_index_n, cont, indices, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// Keeps the combination as indices into cont, which is neither copied nor
+// compared, and advances them without looking at the elements:
+// callback(thread_index, fullset_size, view) receives an
+// index_view<container_type, uint32_t> where view[i] is cont[view.index(i)].
+// Combinations are made by position, so cont may hold duplicates; they come
+// in the same order as compute_all_comb for distinct elements.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_idx_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_comb_range(cpu_index, cpu_cnt, thread_cnt, subset, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const binomial_table<int_type> table(cont.size(), subset);
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return idx_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, start_index, end_index, table, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_idx(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_idx_shard(cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback);
+}
+
+// Copy of the combination an iterator state stands for, for error reporting
+template<typename container_type>
+container_type state_to_container(const std::vector<typename container_type::const_iterator>& state)
+{
+	container_type vec;
+	for(size_t i=0; i<state.size(); ++i)
+	{
+		vec.push_back(*state[i]);
+	}
+	return vec;
+}
+
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool comb_state_loop(const int thread_index, const container_type& cont, std::vector<typename container_type::const_iterator>& state, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    typedef std::vector<typename container_type::const_iterator> state_type;
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, cont.size(), static_cast<const state_type&>(state)))
+                return false;
+            if (j + 1 < end) // the last combination of the slice needs no successor
+                stdcomb::next_combination_with_state(cont.cbegin(), cont.cend(), state.begin(), state.end());
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in comb_state_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), state_to_container<container_type>(state), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in comb_state_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), state_to_container<container_type>(state), oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool state_worker_thread_proc(const int_type thread_index, 
+						const container_type& cont,
+						int_type start_index, 
+						int_type end_index, 
+						const binomial_table<int_type>& table, 
+						callback_type callback,
+						error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+
+	std::vector<uint32_t> results(table.subset());
+	std::iota(results.begin(), results.end(), 0);
+	if(start_index>0)
+	{
+		find_comb(table, start_index, results);
+	}
+	std::vector<typename container_type::const_iterator> state;
+	for(size_t i=0; i<results.size(); ++i)
+	{
+		state.push_back(cont.cbegin() + results[i]);
+	}
+
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return comb_state_loop(thread_index_n, cont, state, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return comb_state_loop(thread_index_n, cont, state, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		bool first = true;
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			if (!first) // the previous sub-range stopped on its last combination
+				stdcomb::next_combination_with_state(cont.cbegin(), cont.cend(), state.begin(), state.end());
+			first = false;
+			return comb_state_loop(thread_index_n, cont, state, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// All threads share cont read-only; each keeps its combination as a
+// vector of const_iterators into cont and steps it with
+// stdcomb::next_combination_with_state, so elements are never copied or
+// compared (operator== is not needed):
+// callback(thread_index, fullset_size, state) where *state[i] is element i.
+// The order is the same as compute_all_comb for distinct elements.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_state_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_comb_range(cpu_index, cpu_cnt, thread_cnt, subset, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const binomial_table<int_type> table(cont.size(), subset);
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return state_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, start_index, end_index, table, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_state(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_state_shard(cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback);
+}
+
+// Like compute_all_comb_shard, but callback receives up to block_size
+// combinations at once, laid out back to back in a flat buffer:
+// callback(thread_index, fullset_size, block, block_cnt, subset, block_start_index)
+// where combination i of the block starts at block[i * subset] and has
+// rank block_start_index + i. The buffer is reused for the next block.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_batched_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t block_size, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("block_size", block_size, error))
+	{
+		err_callback(0, cont.size(), cont, error);
+		return false;
+	}
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_comb_range(cpu_index, cpu_cnt, thread_cnt, subset, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const binomial_table<int_type> table(cont.size(), subset);
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, block_size, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return batched_worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, start_index, end_index, table, block_size, callback, err_callback, pred);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_comb_batched(int_type thread_cnt, uint32_t block_size, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_batched_shard(cpu_index, cpu_cnt, thread_cnt, block_size, subset, cont, callback, err_callback, pred);
+}
+
+// C(n, k) for n <= 64 from the compile-time Pascal's triangle, 0 when k > n
+inline uint64_t mask_binomial(uint32_t n, uint32_t k)
+{
+	return (k > n) ? 0 : concurrent_permcomb::native_tables<uint64_t>::pascal()[n * (n + 1) / 2 + k];
+}
+
+// Finds the subset at index_to_find among the subset-bit masks of fullset
+// bits in increasing numeric (colex) order, the order Gosper's hack walks.
+// The rank of a mask with bits c1 < c2 < ... < ck is the sum of C(ci, i).
+inline bool find_comb_mask(uint32_t fullset, uint32_t subset, uint64_t index_to_find, uint64_t& mask)
+{
+	if (fullset > 64 || subset > fullset || subset == 0 || index_to_find >= mask_binomial(fullset, subset))
+		return false;
+
+	mask = 0;
+	uint32_t bit = fullset;
+	for (uint32_t i = subset; i > 0; --i)
+	{
+		do
+		{
+			--bit;
+		} while (mask_binomial(bit, i) > index_to_find);
+		mask |= uint64_t(1) << bit;
+		index_to_find -= mask_binomial(bit, i);
+	}
+	return true;
+}
+
+// Gosper's hack: the next larger mask with the same number of set bits
+inline uint64_t next_comb_mask(uint64_t mask)
+{
+	const uint64_t lowest = mask & (0 - mask);
+	const uint64_t ripple = mask + lowest;
+	return (((ripple ^ mask) >> 2) >> concurrent_permcomb::ctz64(lowest)) | ripple;
+}
+
+template<typename callback_type, typename error_callback_type>
+bool comb_mask_loop(const int thread_index, uint32_t fullset, uint32_t subset, uint64_t start, uint64_t end, callback_type callback, error_callback_type err_callback)
+{
+    uint64_t mask = 0;
+    find_comb_mask(fullset, subset, start, mask);
+    uint64_t j = start;
+    try
+    {
+        for (; j < end; ++j, mask = next_comb_mask(mask))
+        {
+            if (!callback(thread_index, fullset, mask))
+                return false;
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in comb_mask_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, fullset, mask, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in comb_mask_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, fullset, mask, oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename callback_type, typename error_callback_type>
+bool comb_mask_batched_loop(const int thread_index, uint32_t fullset, uint32_t subset, uint64_t start, uint64_t end, uint32_t block_size, callback_type callback, error_callback_type err_callback)
+{
+    uint64_t mask = 0;
+    find_comb_mask(fullset, subset, start, mask);
+    std::vector<uint64_t> block(block_size);
+    uint64_t j = start;
+    try
+    {
+        while (j < end)
+        {
+            const uint64_t block_start = j;
+            size_t block_cnt = 0;
+            for (; j < end && block_cnt < block_size; ++j, ++block_cnt, mask = next_comb_mask(mask))
+            {
+                block[block_cnt] = mask;
+            }
+            const uint64_t* block_data = block.data();
+            if (!callback(thread_index, fullset, block_data, block_cnt, static_cast<int_type>(block_start)))
+                return false;
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in comb_mask_batched_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, fullset, mask, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in comb_mask_batched_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, fullset, mask, oss.str());
+    }
+    return false;
+}
+
+// Validates and splits the masks; worker is called as
+// worker(thread_index, start_index, end_index) with uint64_t ranks.
+template<typename int_type, typename error_callback_type, typename worker_type>
+bool run_comb_mask_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, uint32_t fullset, error_callback_type err_callback, worker_type worker)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error) ||
+		!concurrent_permcomb::check_positive("subset", subset, error))
+	{
+		err_callback(0, fullset, uint64_t(0), error);
+		return false;
+	}
+	if (fullset > 64)
+	{
+		std::ostringstream oss;
+		oss << "Error: fullset(" << fullset << ") > 64";
+		err_callback(0, fullset, uint64_t(0), oss.str());
+		return false;
+	}
+
+	int_type total_comb=0; 
+	if (!compute_total_comb(fullset, subset, total_comb))
+	{
+		err_callback(0, fullset, uint64_t(0), "Error: compute_total_comb() return false");
+		return false;
+	}
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!concurrent_permcomb::split_cpu_range(total_comb, "total_comb", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
+	{
+		err_callback(0, fullset, uint64_t(0), error);
+		return false;
+	}
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[worker](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return worker(static_cast<int>(thread_index), static_cast<uint64_t>(start_index), static_cast<uint64_t>(end_index));
+	});
+
+	return true;
+}
+
+// Enumerates the subset-element combinations of a fullset of up to 64
+// elements as uint64_t masks, bit i set when element i is selected:
+// callback(thread_index, fullset, mask) and
+// err_callback(thread_index, fullset, mask, error).
+// Masks come in increasing numeric order (colex order of the combinations),
+// which is not the order of compute_all_comb.
+template<typename int_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_mask_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, uint32_t fullset, callback_type callback, error_callback_type err_callback)
+{
+	return run_comb_mask_shard(cpu_index, cpu_cnt, thread_cnt, subset, fullset, err_callback,
+		[fullset, subset, callback, err_callback](int thread_index, uint64_t start_index, uint64_t end_index) -> bool
+	{
+		return comb_mask_loop(thread_index, fullset, subset, start_index, end_index, callback, err_callback);
+	});
+}
+
+template<typename int_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_mask(int_type thread_cnt, uint32_t subset, uint32_t fullset, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_mask_shard(cpu_index, cpu_cnt, thread_cnt, subset, fullset, callback, err_callback);
+}
+
+// Like compute_all_comb_mask_shard, but up to block_size masks per call:
+// callback(thread_index, fullset, masks, mask_cnt, block_start_index)
+template<typename int_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_mask_batched_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t block_size, uint32_t subset, uint32_t fullset, callback_type callback, error_callback_type err_callback)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("block_size", block_size, error))
+	{
+		err_callback(0, fullset, uint64_t(0), error);
+		return false;
+	}
+
+	return run_comb_mask_shard(cpu_index, cpu_cnt, thread_cnt, subset, fullset, err_callback,
+		[fullset, subset, block_size, callback, err_callback](int thread_index, uint64_t start_index, uint64_t end_index) -> bool
+	{
+		return comb_mask_batched_loop<int_type>(thread_index, fullset, subset, start_index, end_index, block_size, callback, err_callback);
+	});
+}
+
+template<typename int_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_mask_batched(int_type thread_cnt, uint32_t block_size, uint32_t subset, uint32_t fullset, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_mask_batched_shard(cpu_index, cpu_cnt, thread_cnt, block_size, subset, fullset, callback, err_callback);
+}
+
+// C(n, k) from table, 0 when k > n. find_comb_revdoor and rank_comb_revdoor
+// only ask for k <= table.subset() and n - k <= table.fullset() - table.subset().
+template<typename int_type>
+int_type revdoor_binomial(const binomial_table<int_type>& table, uint32_t n, uint32_t k)
+{
+	return (k > n) ? int_type(0) : table.get(n, k);
+}
+
+// Revolving door order (Kreher and Stinson, Combinatorial Algorithms 2.3.3):
+// each combination differs from the one before it by one element out and
+// one element in. results holds table.subset() sorted indices into
+// [0, table.fullset()).
+template<typename int_type>
+bool find_comb_revdoor(const binomial_table<int_type>& table, 
+			   int_type index_to_find,
+			   std::vector<uint32_t>& results )
+{
+	const uint32_t fullset = table.fullset();
+	const uint32_t subset = table.subset();
+	if( !table.valid() || subset == 0 || index_to_find < 0 || index_to_find >= table.total() )
+		return false;
+
+	results.resize(subset);
+	uint32_t x = fullset;
+	for (uint32_t i = subset; i >= 1; --i)
+	{
+		while (revdoor_binomial(table, x, i) > index_to_find)
+			--x;
+		results[i - 1] = x; // element x + 1 counting from 1
+		index_to_find = revdoor_binomial(table, x + 1, i) - index_to_find - 1;
+	}
+	return true;
+}
+
+// Fails when C(fullset, subset) does not fit in int_type
+template<typename int_type>
+bool find_comb_revdoor(const uint32_t fullset, 
+			   const uint32_t subset, 
+			   int_type index_to_find,
+			   std::vector<uint32_t>& results )
+{
+	int_type total = 0;
+	if( subset > fullset || fullset == 0 || subset == 0 || !compute_total_comb(fullset, subset, total) )
+		return false;
+
+	const binomial_table<int_type> table(fullset, subset);
+	return find_comb_revdoor(table, index_to_find, results);
+}
+
+// Inverse of find_comb_revdoor for sorted indices
+template<typename int_type>
+bool rank_comb_revdoor(const binomial_table<int_type>& table, const std::vector<uint32_t>& indices, int_type& rank)
+{
+	const uint32_t fullset = table.fullset();
+	const uint32_t subset = table.subset();
+	if (!table.valid() || subset == 0 || indices.size() != subset)
+		return false;
+
+	rank = (subset % 2 == 1) ? -1 : 0;
+	bool add = true;
+	for (uint32_t i = subset; i >= 1; --i)
+	{
+		if (indices[i - 1] >= fullset || (i < subset && indices[i - 1] >= indices[i]))
+			return false;
+
+		const int_type c = revdoor_binomial(table, indices[i - 1] + 1, i);
+		if (add)
+			rank += c;
+		else
+			rank -= c;
+		add = !add;
+	}
+	return true;
+}
+
+// Fails when C(fullset, indices.size()) does not fit in int_type
+template<typename int_type>
+bool rank_comb_revdoor(const uint32_t fullset, const std::vector<uint32_t>& indices, int_type& rank)
+{
+	const uint32_t subset = static_cast<uint32_t>(indices.size());
+	int_type total = 0;
+	if (subset == 0 || subset > fullset || !compute_total_comb(fullset, subset, total))
+		return false;
+
+	const binomial_table<int_type> table(fullset, subset);
+	return rank_comb_revdoor(table, indices, rank);
+}
+
+// Revolving door successor on sorted 0 based indices, with indices[subset]
+// holding fullset as a sentinel. Sets out and in to the index which left
+// and the one which entered. Steps past the last combination to the first.
+inline void next_comb_revdoor(std::vector<uint32_t>& a, uint32_t subset, uint32_t& out, uint32_t& in)
+{
+	uint32_t p = 0;
+	while (p < subset && a[p] == p)
+		++p;
+
+	if ((subset - p) % 2 == 0)
+	{
+		if (p == 0)
+		{
+			out = a[0];
+			in = --a[0];
+		}
+		else
+		{
+			out = (p >= 2) ? p - 2 : 0;
+			in = p;
+			a[p - 1] = p;
+			if (p >= 2)
+				a[p - 2] = p - 1;
+		}
+	}
+	else if (a[p + 1] != a[p] + 1)
+	{
+		out = (p >= 1) ? p - 1 : a[p];
+		in = a[p] + 1;
+		if (p >= 1)
+			a[p - 1] = a[p];
+		++a[p];
+	}
+	else
+	{
+		out = a[p + 1];
+		in = p;
+		a[p + 1] = a[p];
+		a[p] = p;
+	}
+}
+
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool comb_revdoor_loop(const int thread_index, const container_type& cont, std::vector<uint32_t>& indices, uint32_t subset, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    const concurrent_permcomb::index_view<container_type, uint32_t> view(cont, indices.data(), subset);
+    uint32_t out = 0;
+    uint32_t in = 0; // same as out for the first combination: nothing changed
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, cont.size(), view, out, in))
+                return false;
+            next_comb_revdoor(indices, subset, out, in);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in comb_revdoor_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        indices.resize(subset);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in comb_revdoor_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        indices.resize(subset);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool revdoor_worker_thread_proc(const int_type thread_index, 
+						const container_type& cont,
+						int_type start_index, 
+						int_type end_index, 
+						const binomial_table<int_type>& table, 
+						callback_type callback,
+						error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	const uint32_t subset = table.subset();
+
+	std::vector<uint32_t> indices;
+	find_comb_revdoor(table, start_index, indices);
+	indices.push_back(static_cast<uint32_t>(cont.size())); // sentinel
+
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return comb_revdoor_loop(thread_index_n, cont, indices, subset, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return comb_revdoor_loop(thread_index_n, cont, indices, subset, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return comb_revdoor_loop(thread_index_n, cont, indices, subset, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// Visits the combinations in revolving door order, so each differs from the
+// one before it by exactly one element:
+// callback(thread_index, fullset_size, view, out, in) where view is an
+// index_view<container_type, uint32_t> with sorted indices, and out and in
+// are the indices into cont of the element which left and the one which
+// entered. The first combination of every thread has out == in since there
+// is nothing to update from.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_revdoor_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_comb_range(cpu_index, cpu_cnt, thread_cnt, subset, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const binomial_table<int_type> table(cont.size(), subset);
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return revdoor_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, start_index, end_index, table, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_revdoor(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_revdoor_shard(cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback);
+}
+
+// Combinations with repetition (multichoose) of subset elements drawn from
+// the fullset distinct elements of cont, as non-decreasing indices into cont.
+// Taking indices[i] + i maps them one to one onto the combinations of
+// subset out of fullset + subset - 1, which is how they are counted and
+// unranked, so the order is lexicographic too.
+template<typename int_type>
+bool compute_total_multichoose( const uint32_t fullset, const uint32_t subset, int_type& total )
+{
+	if (fullset == 0 || subset == 0)
+		return false;
+
+	return compute_total_comb(fullset + subset - 1, subset, total);
+}
+
+// table must be binomial_table(fullset + subset - 1, subset)
+template<typename int_type>
+bool find_multichoose(const binomial_table<int_type>& table, 
+			   int_type index_to_find,
+			   std::vector<uint32_t>& results )
+{
+	if (!find_comb(table, index_to_find, results))
+		return false;
+
+	for (uint32_t i = 0; i < results.size(); ++i)
+	{
+		results[i] -= i;
+	}
+	return true;
+}
+
+template<typename int_type>
+bool find_multichoose(const uint32_t fullset, 
+			   const uint32_t subset, 
+			   int_type index_to_find,
+			   std::vector<uint32_t>& results )
+{
+	int_type total = 0;
+	if (!compute_total_multichoose(fullset, subset, total))
+		return false;
+
+	const binomial_table<int_type> table(fullset + subset - 1, subset);
+	return find_multichoose(table, index_to_find, results);
+}
+
+// Advances non-decreasing indices out of [0, fullset) to the next multiset:
+// the rightmost index below fullset - 1 is bumped and everything after it
+// takes the same value, so this is O(1) amortized. Returns false after the
+// last multiset.
+inline bool next_multichoose(std::vector<uint32_t>& indices, uint32_t fullset)
+{
+	uint32_t i = static_cast<uint32_t>(indices.size());
+	while (i > 0 && indices[i - 1] == fullset - 1)
+		--i;
+	if (i == 0)
+		return false;
+
+	const uint32_t value = ++indices[i - 1];
+	std::fill(indices.begin() + i, indices.end(), value);
+	return true;
+}
+
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool multichoose_loop(const int thread_index, const container_type& cont, std::vector<uint32_t>& indices, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    const uint32_t fullset = static_cast<uint32_t>(cont.size());
+    const concurrent_permcomb::index_view<container_type, uint32_t> view(cont, indices.data(), indices.size());
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, cont.size(), view))
+                return false;
+            next_multichoose(indices, fullset);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in multichoose_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in multichoose_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool multichoose_worker_thread_proc(const int_type thread_index, 
+						const container_type& cont,
+						int_type start_index, 
+						int_type end_index, 
+						const binomial_table<int_type>& table, 
+						callback_type callback,
+						error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+
+	std::vector<uint32_t> indices(table.subset(), 0);
+	if(start_index>0)
+	{
+		find_multichoose(table, start_index, indices);
+	}
+
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return multichoose_loop(thread_index_n, cont, indices, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return multichoose_loop(thread_index_n, cont, indices, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return multichoose_loop(thread_index_n, cont, indices, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// Visits the C(fullset + subset - 1, subset) ways to choose subset elements
+// of cont with repetition, where cont holds distinct elements and subset may
+// exceed cont.size(): callback(thread_index, fullset_size, view) receives an
+// index_view<container_type, uint32_t> over non-decreasing indices.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_multichoose_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error) ||
+		!concurrent_permcomb::check_positive("subset", subset, error) ||
+		!concurrent_permcomb::check_positive("fullset", cont.size(), error))
+	{
+		err_callback(0, cont.size(), cont, error);
+		return false;
+	}
+
+	int_type total = 0;
+	if (!compute_total_multichoose(static_cast<uint32_t>(cont.size()), subset, total))
+	{
+		err_callback(0, cont.size(), cont, "Error: total_multichoose does not fit int_type");
+		return false;
+	}
+
+	const binomial_table<int_type> table(static_cast<uint32_t>(cont.size()) + subset - 1, subset);
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!concurrent_permcomb::split_cpu_range(total, "total_multichoose", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
+	{
+		err_callback(0, cont.size(), cont, error);
+		return false;
+	}
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return multichoose_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, start_index, end_index, table, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_multichoose(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_multichoose_shard(cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback);
+}
+
+// Order of compute_all_subsets
+enum class subset_order
+{
+	by_size,       // smaller subsets first, each size in lexicographic order
+	binary_counter // subset i holds element b for every bit b set in i
+};
+
+// Number of subsets of fullset with a size in [min_size, max_size];
+// returns false when the count or any partial sum does not fit int_type
+template<typename int_type>
+bool compute_total_subsets(const uint32_t fullset, const uint32_t min_size, const uint32_t max_size, int_type& total)
+{
+	if (min_size > max_size || max_size > fullset)
+		return false;
+
+	int_type result = 0;
+	for (uint32_t size = min_size; size <= max_size; ++size)
+	{
+		int_type size_total = 0;
+		if (!compute_total_comb(fullset, size, size_total))
+			return false;
+		if (concurrent_permcomb::int_limits<int_type>::is_bounded && result > concurrent_permcomb::int_limits<int_type>::max() - size_total)
+			return false;
+		result += size_total;
+	}
+	total = result;
+
+	return true;
+}
+
+// Binomial tables for every subset size in [min_size, max_size] of the
+// subsets of fullset, which together make up one rank space; the caller
+// checks compute_total_subsets first, as the sums here are unchecked.
+template<typename int_type>
+class subset_size_tables
+{
+public:
+	subset_size_tables(uint32_t fullset, uint32_t min_size, uint32_t max_size)
+		: m_min_size(min_size)
+		, m_total(0)
+	{
+		for (uint32_t size = min_size; size <= max_size; ++size)
+		{
+			m_tables.push_back(binomial_table<int_type>(fullset, size));
+			m_total += m_tables.back().total();
+		}
+	}
+	const int_type& total() const
+	{
+		return m_total;
+	}
+	// finds the subset at index_to_find as sorted indices
+	void find(int_type index_to_find, std::vector<uint32_t>& results) const
+	{
+		uint32_t i = 0;
+		while (index_to_find >= m_tables[i].total())
+		{
+			index_to_find -= m_tables[i].total();
+			++i;
+		}
+		results.clear();
+		if (m_min_size + i > 0)
+			find_comb(m_tables[i], index_to_find, results);
+	}
+
+private:
+	uint32_t m_min_size;
+	int_type m_total;
+	std::vector<binomial_table<int_type> > m_tables;
+};
+
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool subsets_by_size_loop(const int thread_index, const container_type& cont, std::vector<uint32_t>& indices, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    typedef concurrent_permcomb::index_view<container_type, uint32_t> view_type;
+    const uint32_t fullset = static_cast<uint32_t>(cont.size());
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, cont.size(), view_type(cont, indices.data(), indices.size())))
+                return false;
+            if (!next_comb_idx(indices, fullset))
+            {
+                // first subset of the next size
+                indices.resize(indices.size() + 1);
+                std::iota(indices.begin(), indices.end(), 0);
+            }
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in subsets_by_size_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in subsets_by_size_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    return false;
+}
+
+// The subset is kept sorted at the back of buffer, from buffer[first] on.
+// Adding 1 to the counter replaces the run of indices 0, 1 .. t-1 at the
+// front by t, which is O(1) amortized.
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool subsets_binary_loop(const int thread_index, const container_type& cont, std::vector<uint32_t>& buffer, uint32_t& first, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    typedef concurrent_permcomb::index_view<container_type, uint32_t> view_type;
+    const uint32_t fullset = static_cast<uint32_t>(cont.size());
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, cont.size(), view_type(cont, buffer.data() + first, fullset - first)))
+                return false;
+
+            uint32_t t = 0;
+            while (first + t < fullset && buffer[first + t] == t)
+                ++t;
+            if (t == fullset)
+                break; // past the last subset
+            first = first + t - 1;
+            buffer[first] = t;
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in subsets_binary_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, std::vector<uint32_t>(buffer.begin() + first, buffer.end())), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in subsets_binary_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, std::vector<uint32_t>(buffer.begin() + first, buffer.end())), oss.str());
+    }
+    return false;
+}
+
+// Seeds buffer with the subset at start_index: the sorted indices for
+// by_size, or for binary the bits of start_index kept sorted at the back of
+// buffer from buffer[first] on, as subsets_binary_loop wants them.
+template<typename int_type>
+void find_subsets_state(subset_order order, uint32_t fullset, const subset_size_tables<int_type>& tables, const int_type& start_index, std::vector<uint32_t>& buffer, uint32_t& first)
+{
+	if (order == subset_order::by_size)
+	{
+		buffer.reserve(fullset);
+		tables.find(start_index, buffer);
+		first = 0;
+		return;
+	}
+
+	// bits of start_index from the highest, so the indices end up sorted
+	std::vector<uint32_t> bits;
+	int_type rest = start_index;
+	for (uint32_t b = 0; rest > 0; ++b, rest /= 2)
+	{
+		if (rest % 2 == 1)
+			bits.push_back(b);
+	}
+	buffer.assign(fullset, 0);
+	first = fullset - static_cast<uint32_t>(bits.size());
+	std::copy(bits.begin(), bits.end(), buffer.begin() + first);
+}
+
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool subsets_loop(subset_order order, const int thread_index, const container_type& cont, std::vector<uint32_t>& buffer, uint32_t& first, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+	if (order == subset_order::by_size)
+		return subsets_by_size_loop(thread_index, cont, buffer, start, end, callback, err_callback);
+	return subsets_binary_loop(thread_index, cont, buffer, first, start, end, callback, err_callback);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool subsets_worker_thread_proc(const int_type thread_index, 
+						const container_type& cont,
+						int_type start_index, 
+						int_type end_index, 
+						subset_order order,
+						const subset_size_tables<int_type>& tables, 
+						callback_type callback,
+						error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+
+	std::vector<uint32_t> buffer;
+	uint32_t first = 0;
+	find_subsets_state(order, static_cast<uint32_t>(cont.size()), tables, start_index, buffer, first);
+
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return subsets_loop(order, thread_index_n, cont, buffer, first, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return subsets_loop(order, thread_index_n, cont, buffer, first, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return subsets_loop(order, thread_index_n, cont, buffer, first, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// Visits every subset of cont with between min_size and max_size elements
+// as one rank space, so all sizes are split evenly across cpus and threads
+// in a single run: callback(thread_index, fullset_size, view) receives an
+// index_view<container_type, uint32_t> over sorted indices, empty for the
+// empty subset. subset_order::binary_counter needs the whole power set,
+// min_size 0 and max_size cont.size().
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_subsets_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t min_size, uint32_t max_size, subset_order order, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error) ||
+		!concurrent_permcomb::check_positive("fullset", cont.size(), error))
+	{
+		err_callback(0, cont.size(), cont, error);
+		return false;
+	}
+
+	const uint32_t fullset = static_cast<uint32_t>(cont.size());
+	if (min_size > max_size || max_size > fullset)
+	{
+		std::ostringstream oss;
+		oss << "Error: subset sizes [" << min_size << ", " << max_size;
+		oss << "] not within [0, " << fullset << "]";
+		err_callback(0, cont.size(), cont, oss.str());
+		return false;
+	}
+	if (order == subset_order::binary_counter && (min_size != 0 || max_size != fullset))
+	{
+		err_callback(0, cont.size(), cont, "Error: subset_order::binary_counter needs all subset sizes");
+		return false;
+	}
+
+	int_type total = 0;
+	if (!compute_total_subsets(fullset, min_size, max_size, total))
+	{
+		err_callback(0, cont.size(), cont, "Error: total_subsets does not fit int_type");
+		return false;
+	}
+	const subset_size_tables<int_type> tables(fullset, min_size, max_size);
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!concurrent_permcomb::split_cpu_range(total, "total_subsets", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
+	{
+		err_callback(0, cont.size(), cont, error);
+		return false;
+	}
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &tables, order, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return subsets_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, start_index, end_index, order, tables, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_subsets(int_type thread_cnt, uint32_t min_size, uint32_t max_size, subset_order order, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_subsets_shard(cpu_index, cpu_cnt, thread_cnt, min_size, max_size, order, cont, callback, err_callback);
+}
+
+template<typename value_type, typename predicate_type>
+typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+elem_less(const value_type& a, const value_type& b, predicate_type pred)
+{
+	return pred(a, b);
+}
+
+template<typename value_type, typename predicate_type>
+typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+elem_less(const value_type& a, const value_type& b, predicate_type)
+{
+	return a < b;
+}
+
+// Sorted copy of cont with the size of every run of equivalent elements
+template<typename container_type, typename predicate_type>
+void group_multiset(const container_type& cont, predicate_type pred, container_type& sorted, std::vector<uint32_t>& group_counts, std::vector<size_t>& group_first)
+{
+	typedef typename container_type::value_type value_type;
+	sorted.assign(cont.cbegin(), cont.cend());
+	std::sort(sorted.begin(), sorted.end(), [pred](const value_type& a, const value_type& b) { return elem_less(a, b, pred); });
+
+	group_counts.clear();
+	group_first.clear();
+	for (size_t i = 0; i < sorted.size(); ++i)
+	{
+		if (i == 0 || elem_less(sorted[i - 1], sorted[i], pred))
+		{
+			group_counts.push_back(0);
+			group_first.push_back(i);
+		}
+		++group_counts.back();
+	}
+}
+
+// ways(g, r): the number of ways to take r elements out of groups g and
+// after, with at most group_counts[h] copies of group h. A combination of a
+// multiset is kept as the non-decreasing group index of each element.
+// Only ways(g, r) with r >= subset - (copies before group g) is filled in;
+// those are the ones ever read, and none exceeds total(), so fits() is
+// false exactly when total() does not fit int_type.
+template<typename int_type>
+class multiset_comb_table
+{
+public:
+	multiset_comb_table(const std::vector<uint32_t>& group_counts, uint32_t subset)
+		: m_group_counts(group_counts)
+		, m_suffix_counts(group_counts.size() + 1, 0)
+		, m_subset(subset)
+		, m_ways((group_counts.size() + 1) * (subset + 1), int_type(0))
+		, m_fits(true)
+	{
+		const size_t group_cnt = group_counts.size();
+		for (size_t g = group_cnt; g-- > 0; )
+		{
+			m_suffix_counts[g] = m_suffix_counts[g + 1] + group_counts[g];
+		}
+
+		m_ways[group_cnt * (subset + 1)] = 1;
+		for (size_t g = group_cnt; g-- > 0; )
+		{
+			const uint32_t before = m_suffix_counts[0] - m_suffix_counts[g];
+			const uint32_t lowest = (subset > before) ? subset - before : 0;
+			const uint32_t first = (lowest > group_counts[g]) ? lowest - group_counts[g] : 0;
+			// ways(g + 1, r - group_counts[g]) + ... + ways(g + 1, r) as a sliding sum,
+			// subtracting first so that window never exceeds ways(g, r)
+			int_type window = 0;
+			for (uint32_t r = first; r <= subset; ++r)
+			{
+				if (r > first + group_counts[g])
+					window -= ways(g + 1, r - group_counts[g] - 1);
+				const int_type& next = ways(g + 1, r);
+				if (concurrent_permcomb::int_limits<int_type>::is_bounded && window > concurrent_permcomb::int_limits<int_type>::max() - next)
+				{
+					m_fits = false;
+					return;
+				}
+				window += next;
+				if (r >= lowest)
+					m_ways[g * (subset + 1) + r] = window;
+			}
+		}
+	}
+	// false when the number of combinations does not fit int_type
+	bool fits() const
+	{
+		return m_fits;
+	}
+	uint32_t subset() const
+	{
+		return m_subset;
+	}
+	uint32_t group_cnt() const
+	{
+		return static_cast<uint32_t>(m_group_counts.size());
+	}
+	uint32_t group_count(uint32_t g) const
+	{
+		return m_group_counts[g];
+	}
+	// copies of groups g and after
+	uint32_t suffix_count(uint32_t g) const
+	{
+		return m_suffix_counts[g];
+	}
+	const int_type& ways(size_t g, uint32_t r) const
+	{
+		return m_ways[g * (m_subset + 1) + r];
+	}
+	// distinct combinations of subset elements
+	const int_type& total() const
+	{
+		return m_ways[m_subset];
+	}
+
+private:
+	std::vector<uint32_t> m_group_counts;
+	std::vector<uint32_t> m_suffix_counts;
+	uint32_t m_subset;
+	std::vector<int_type> m_ways;
+	bool m_fits;
+};
+
+template<typename int_type>
+bool compute_total_multiset_comb(const std::vector<uint32_t>& group_counts, uint32_t subset, int_type& total)
+{
+	const multiset_comb_table<int_type> table(group_counts, subset);
+	if (!table.fits())
+		return false;
+	total = table.total();
+
+	return true;
+}
+
+// Finds the combination at index_to_find in lexicographic order; results
+// holds the group index of each element. More copies of an earlier group
+// come first, so the copies of group g are tried from the most down.
+template<typename int_type>
+bool find_multiset_comb(const multiset_comb_table<int_type>& table,
+	int_type index_to_find,
+	std::vector<uint32_t>& results)
+{
+	if (!table.fits() || table.subset() == 0 || index_to_find >= table.total())
+		return false;
+
+	results.clear();
+	uint32_t remaining = table.subset();
+	for (uint32_t g = 0; g < table.group_cnt() && remaining > 0; ++g)
+	{
+		for (uint32_t x = std::min(table.group_count(g), remaining); ; --x)
+		{
+			const int_type& cnt = table.ways(g + 1, remaining - x);
+			if (index_to_find < cnt)
+			{
+				results.insert(results.end(), x, g);
+				remaining -= x;
+				break;
+			}
+			index_to_find -= cnt;
+		}
+	}
+	return true;
+}
+
+// Advances the group indices to the next combination: the rightmost element
+// which can move to a later group does so, and the elements after it take
+// the earliest groups left. changed_pos is set to the first element which
+// changed. Returns false after the last combination.
+template<typename int_type>
+bool next_multiset_comb(std::vector<uint32_t>& groups, const multiset_comb_table<int_type>& table, uint32_t& changed_pos)
+{
+	const uint32_t subset = static_cast<uint32_t>(groups.size());
+	for (uint32_t i = subset; i-- > 0; )
+	{
+		uint32_t g = groups[i] + 1;
+		if (table.suffix_count(g) < subset - i)
+			continue;
+
+		uint32_t left = table.group_count(g);
+		for (uint32_t j = i; j < subset; ++j)
+		{
+			while (left == 0)
+			{
+				left = table.group_count(++g);
+			}
+			groups[j] = g;
+			--left;
+		}
+		changed_pos = i;
+		return true;
+	}
+	return false;
+}
+
+template<typename int_type, typename vector_type>
+vector_type find_multiset_comb_by_idx(const uint32_t subset,
+	int_type index_to_find,
+	vector_type& original_vector)
+{
+	vector_type sorted;
+	std::vector<uint32_t> group_counts;
+	std::vector<size_t> group_first;
+	group_multiset(original_vector, no_predicate_type(), sorted, group_counts, group_first);
+
+	const multiset_comb_table<int_type> table(group_counts, subset);
+	std::vector<uint32_t> integer_results;
+	vector_type results;
+	if (find_multiset_comb(table, index_to_find, integer_results))
+	{
+		for (uint32_t g : integer_results)
+		{
+			results.push_back(sorted[group_first[g]]);
+		}
+	}
+	return results;
+}
+
+template<typename int_type, typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool multiset_comb_loop(const int thread_index, const container_type& sorted, const std::vector<size_t>& group_first, const multiset_comb_table<int_type>& table, std::vector<uint32_t>& groups, container_type& cont, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    const uint32_t subset = table.subset();
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, sorted.size(), static_cast<const container_type&>(cont)))
+                return false;
+            uint32_t changed_pos = subset;
+            next_multiset_comb(groups, table, changed_pos);
+            for (uint32_t i = changed_pos; i < subset; ++i)
+            {
+                cont[i] = sorted[group_first[groups[i]]];
+            }
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in multiset_comb_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, sorted.size(), cont, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in multiset_comb_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, sorted.size(), cont, oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool multiset_comb_worker_thread_proc(const int_type thread_index, 
+						const container_type& sorted,
+						const std::vector<size_t>& group_first,
+						const multiset_comb_table<int_type>& table,
+						int_type start_index, 
+						int_type end_index, 
+						callback_type callback,
+						error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+
+	std::vector<uint32_t> groups;
+	find_multiset_comb(table, start_index, groups);
+	container_type cont;
+	for (size_t i = 0; i < groups.size(); ++i)
+	{
+		cont.push_back(sorted[group_first[groups[i]]]);
+	}
+
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return multiset_comb_loop(thread_index_n, sorted, group_first, table, groups, cont, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return multiset_comb_loop(thread_index_n, sorted, group_first, table, groups, cont, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return multiset_comb_loop(thread_index_n, sorted, group_first, table, groups, cont, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// Visits every distinct combination of subset elements of cont exactly once,
+// in lexicographic order, even when cont holds duplicates. The combination
+// passed to callback is sorted. Elements are equivalent when neither is
+// less than the other by pred (operator< when no predicate is given).
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_multiset_comb_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error) ||
+		!concurrent_permcomb::check_positive("subset", subset, error))
+	{
+		err_callback(0, cont.size(), cont, error);
+		return false;
+	}
+	if (subset > cont.size())
+	{
+		std::ostringstream oss;
+		oss << "Error: subset(" << subset << ") > fullset(" << cont.size() << ")";
+		err_callback(0, cont.size(), cont, oss.str());
+		return false;
+	}
+
+	container_type sorted;
+	std::vector<uint32_t> group_counts;
+	std::vector<size_t> group_first;
+	group_multiset(cont, pred, sorted, group_counts, group_first);
+
+	const multiset_comb_table<int_type> table(group_counts, subset);
+	if (!table.fits())
+	{
+		err_callback(0, cont.size(), cont, "Error: total_multiset_comb does not fit int_type");
+		return false;
+	}
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!concurrent_permcomb::split_cpu_range(table.total(), "total_multiset_comb", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
+	{
+		err_callback(0, cont.size(), cont, error);
+		return false;
+	}
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&sorted, &group_first, &table, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return multiset_comb_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, sorted, group_first, table, start_index, end_index, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_multiset_comb(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_multiset_comb_shard(cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback, pred);
+}
+
+// First position which next_comb_idx is going to change, or 0 when indices
+// is the last combination.
+inline uint32_t next_comb_idx_pivot(const std::vector<uint32_t>& indices, uint32_t fullset)
+{
+	const uint32_t subset = static_cast<uint32_t>(indices.size());
+	uint32_t i = subset;
+	while (i > 0 && indices[i - 1] == fullset - subset + i - 1)
+		--i;
+	return (i > 0) ? i - 1 : 0;
+}
+
+// callback(thread_index, fullset_size, view, changed_pos, prune_len) is told
+// the first position that differs from the previous combination. Setting
+// prune_len to p skips the rest of the combinations sharing the first p
+// indices: the C(fullset-1-indices[p-1], subset-p) of them form one block,
+// and the current one is preceded by its local rank in the block, so the
+// counter moves 1 + sum of C(fullset-1-indices[i], subset-i) for i >= p
+// ahead. Setting the tail to its largest values then next_comb_idx brings
+// indices to the start of the next block. The rank at counter j is base + j,
+// worked out only to skip. A skip past end leaves indices on the block it
+// jumped to and sets skip to how far past.
+template<typename int_type, typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool comb_pruned_loop(const int thread_index, const container_type& cont, const binomial_table<int_type>& table, std::vector<uint32_t>& indices, const int_type& base, const index_type& start, const index_type& end, uint32_t& changed_pos, int_type& skip, callback_type callback, error_callback_type err_callback)
+{
+    const uint32_t fullset = static_cast<uint32_t>(cont.size());
+    const uint32_t subset = static_cast<uint32_t>(indices.size());
+    const concurrent_permcomb::index_view<container_type, uint32_t> view(cont, indices.data(), indices.size());
+    index_type j = start;
+    try
+    {
+        while (j < end)
+        {
+            uint32_t prune_len = 0;
+            if (!callback(thread_index, cont.size(), view, changed_pos, prune_len))
+                return false;
+
+            if (prune_len > 0 && prune_len < subset)
+            {
+                int_type block_rest = 1;
+                for (uint32_t i = prune_len; i < subset; ++i)
+                {
+                    const uint32_t remaining_set = fullset - 1 - indices[i];
+                    if (remaining_set >= subset - i)
+                        block_rest += table.get(remaining_set, subset - i);
+                    indices[i] = fullset - subset + i;
+                }
+                const int_type next_block = base + static_cast<int_type>(j) + block_rest;
+                const int_type sub_end = base + static_cast<int_type>(end);
+                if (next_block >= sub_end)
+                {
+                    skip = next_block - sub_end;
+                    j = end;
+                }
+                else
+                {
+                    j = static_cast<index_type>(next_block - base);
+                }
+            }
+            else
+            {
+                ++j;
+            }
+            changed_pos = next_comb_idx_pivot(indices, fullset);
+            next_comb_idx(indices, fullset);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in comb_pruned_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in comb_pruned_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont.size(), view_to_container(cont, indices), oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool pruned_worker_thread_proc(const int_type thread_index, 
+						const container_type& cont,
+						int_type start_index, 
+						int_type end_index, 
+						const binomial_table<int_type>& table, 
+						callback_type callback,
+						error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+
+	std::vector<uint32_t> indices(table.subset());
+	std::iota(indices.begin(), indices.end(), 0);
+	if(start_index>0)
+	{
+		find_comb(table, start_index, indices);
+	}
+	uint32_t changed_pos = 0;
+	int_type skip = 0; // past the end of the slice, so not used
+
+	if(end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{ 
+		const int start_i = static_cast<int>(start_index);
+		const int end_i = static_cast<int>(end_index);
+		return comb_pruned_loop(thread_index_n, cont, table, indices, int_type(0), start_i, end_i, changed_pos, skip, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return comb_pruned_loop(thread_index_n, cont, table, indices, int_type(0), start_i, end_i, changed_pos, skip, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges_skipping(start_index, end_index, [&](const int_type& sub_start, uint64_t cnt, int_type& skip) -> bool
+		{
+			return comb_pruned_loop(thread_index_n, cont, table, indices, sub_start, uint64_t(0), cnt, changed_pos, skip, callback, err_callback);
+		});
+	}
+}
+
+// Like compute_all_comb_idx_shard, but callback can prune whole prefixes:
+// callback(thread_index, fullset_size, view, changed_pos, prune_len) where
+// view is an index_view<container_type, uint32_t>, changed_pos is the first
+// position changed since the previous combination of the thread (0 for its
+// first), and setting prune_len to p skips every later combination starting
+// with the same p elements. Skips never cross the end of a thread's slice,
+// so the split stays the same as compute_all_comb_shard.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_pruned_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_comb_range(cpu_index, cpu_cnt, thread_cnt, subset, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const binomial_table<int_type> table(cont.size(), subset);
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &table, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return pruned_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, start_index, end_index, table, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_comb_pruned(int_type thread_cnt, uint32_t subset, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_comb_pruned_shard(cpu_index, cpu_cnt, thread_cnt, subset, cont, callback, err_callback);
+}
+
+}
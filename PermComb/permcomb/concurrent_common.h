@@ -0,0 +1,698 @@
+///////////////////////////////////////////////////////////////////////////////
+// concurrent_common.h header file
+//
+// Work splitting shared by Concurrent Permutation and Combination
+// Copyright 2016 Wong Shao Voon
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+// version 0.2.0: Static thread slices and chunked work stealing
+// version 0.3.0: Slices and chunks can run on a thread_pool
+// version 0.4.0: Added ctz64
+// version 0.5.0: Added index_view
+// version 0.6.0: Added cancel_token and run_status
+// version 0.7.0: Added popcount64
+// version 0.8.0: Added run_native_sub_ranges and run_native_sub_ranges_skipping
+// version 0.9.0: Added to_str and int_limits for unsigned __int128
+// version 0.10.0: Added native_tables of compile-time factorials and binomials
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <sstream>
+#include <limits>
+#include <utility>
+#include <type_traits>
+#include "thread_pool.h"
+
+namespace concurrent_permcomb
+{
+
+// Index of the lowest set bit, x must not be 0
+inline uint32_t ctz64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return static_cast<uint32_t>(__builtin_ctzll(x));
+#else
+	uint32_t n = 0;
+	while ((x & 1) == 0)
+	{
+		x >>= 1;
+		++n;
+	}
+	return n;
+#endif
+}
+
+// Number of set bits
+inline uint32_t popcount64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return static_cast<uint32_t>(__builtin_popcountll(x));
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return static_cast<uint32_t>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Read-only view of a permutation or combination kept as indices into the
+// original container, so the elements themselves are never copied or moved.
+template<typename container_type, typename index_type>
+class index_view
+{
+public:
+	typedef typename container_type::value_type value_type;
+
+	index_view(const container_type& cont, const index_type* indices, size_t size)
+		: m_cont(cont)
+		, m_indices(indices)
+		, m_size(size)
+	{
+	}
+	const value_type& operator[](size_t i) const
+	{
+		return m_cont[m_indices[i]];
+	}
+	size_t size() const
+	{
+		return m_size;
+	}
+	// position in the original container of element i
+	size_t index(size_t i) const
+	{
+		return m_indices[i];
+	}
+	const index_type* indices() const
+	{
+		return m_indices;
+	}
+	const container_type& container() const
+	{
+		return m_cont;
+	}
+
+private:
+	const container_type& m_cont;
+	const index_type* m_indices;
+	size_t m_size;
+};
+
+// Shared flag which stops every worker of a run once any callback or any
+// other thread trips it. Workers only look at it every
+// cancel_check_interval results, so stopping is prompt but not immediate.
+class cancel_token
+{
+public:
+	cancel_token()
+		: m_cancelled(false)
+	{
+	}
+
+	cancel_token(const cancel_token&) = delete;
+	cancel_token& operator=(const cancel_token&) = delete;
+
+	void cancel()
+	{
+		m_cancelled.store(true, std::memory_order_relaxed);
+	}
+	bool is_cancelled() const
+	{
+		return m_cancelled.load(std::memory_order_relaxed);
+	}
+	// make the token usable for another run
+	void reset()
+	{
+		m_cancelled.store(false, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<bool> m_cancelled;
+};
+
+enum class run_status
+{
+	completed, // every result was visited
+	cancelled, // the token was tripped before the end
+	failed     // err_callback was called
+};
+
+const uint32_t cancel_check_interval = 64;
+
+// Callback wrapper which stops when the token is tripped, and trips the
+// token when the user callback returns false.
+template<typename callback_type>
+class cancellable_callback
+{
+public:
+	cancellable_callback(callback_type callback, cancel_token& token)
+		: m_callback(callback)
+		, m_token(&token)
+		, m_countdown(1) // look at the token before the first result
+	{
+	}
+
+	template<typename... arg_types>
+	bool operator()(arg_types&&... args)
+	{
+		if (--m_countdown == 0)
+		{
+			m_countdown = cancel_check_interval;
+			if (m_token->is_cancelled())
+				return false;
+		}
+		if (!m_callback(std::forward<arg_types>(args)...))
+		{
+			m_token->cancel();
+			return false;
+		}
+		return true;
+	}
+
+private:
+	callback_type m_callback;
+	cancel_token* m_token;
+	uint32_t m_countdown;
+};
+
+// Error callback wrapper which records the failure and stops the other workers
+template<typename error_callback_type>
+class cancelling_err_callback
+{
+public:
+	cancelling_err_callback(error_callback_type err_callback, cancel_token& token, std::atomic<bool>& failed)
+		: m_err_callback(err_callback)
+		, m_token(&token)
+		, m_failed(&failed)
+	{
+	}
+
+	template<typename... arg_types>
+	void operator()(arg_types&&... args)
+	{
+		m_failed->store(true);
+		m_token->cancel();
+		m_err_callback(std::forward<arg_types>(args)...);
+	}
+
+private:
+	error_callback_type m_err_callback;
+	cancel_token* m_token;
+	std::atomic<bool>* m_failed;
+};
+
+template<typename callback_type>
+cancellable_callback<callback_type> make_cancellable_callback(callback_type callback, cancel_token& token)
+{
+	return cancellable_callback<callback_type>(callback, token);
+}
+
+template<typename error_callback_type>
+cancelling_err_callback<error_callback_type> make_cancelling_err_callback(error_callback_type err_callback, cancel_token& token, std::atomic<bool>& failed)
+{
+	return cancelling_err_callback<error_callback_type>(err_callback, token, failed);
+}
+
+inline run_status get_run_status(const cancel_token& token, const std::atomic<bool>& failed)
+{
+	if (failed.load())
+		return run_status::failed;
+	if (token.is_cancelled())
+		return run_status::cancelled;
+	return run_status::completed;
+}
+
+// std::numeric_limits with __int128 filled in, since strict C++11 mode
+// leaves it unspecialized. Use this for anything that asks about an int_type.
+template<typename int_type>
+struct int_limits : std::numeric_limits<int_type>
+{
+};
+
+#if defined(__SIZEOF_INT128__)
+// __extension__ keeps -pedantic quiet about __int128
+__extension__ typedef unsigned __int128 uint128_type;
+__extension__ typedef __int128 int128_type;
+
+template<>
+struct int_limits<uint128_type>
+{
+	static const bool is_specialized = true;
+	static const bool is_signed = false;
+	static const bool is_bounded = true;
+	static const int digits = 128;
+	static constexpr uint128_type min() { return 0; }
+	static constexpr uint128_type max() { return ~static_cast<uint128_type>(0); }
+};
+
+template<>
+struct int_limits<int128_type>
+{
+	static const bool is_specialized = true;
+	static const bool is_signed = true;
+	static const bool is_bounded = true;
+	static const int digits = 127;
+	static constexpr int128_type min() { return -max() - 1; }
+	static constexpr int128_type max() { return static_cast<int128_type>(int_limits<uint128_type>::max() >> 1); }
+};
+#endif
+
+// int_type as text for error messages
+template<typename int_type>
+std::string to_str(const int_type& value)
+{
+	std::ostringstream oss;
+	oss << value;
+	return oss.str();
+}
+
+#if defined(__SIZEOF_INT128__)
+// ostream has no operator<< for __int128
+inline std::string to_str(uint128_type value)
+{
+	char buf[40];
+	char* p = buf + sizeof(buf);
+	*--p = '\0';
+	do
+	{
+		*--p = static_cast<char>('0' + static_cast<int>(value % 10));
+		value /= 10;
+	} while (value != 0);
+	return std::string(p);
+}
+
+inline std::string to_str(int128_type value)
+{
+	if (value >= 0)
+		return to_str(static_cast<uint128_type>(value));
+	return "-" + to_str(static_cast<uint128_type>(0) - static_cast<uint128_type>(value));
+}
+#endif
+
+// 0, 1, ... n-1 as a template parameter pack. Built by halves, so the
+// instantiation depth is log(n) and large tables stay within compiler limits.
+template<uint32_t... ns>
+struct index_seq
+{
+};
+
+template<typename first_type, typename second_type>
+struct concat_index_seq;
+
+template<uint32_t... first, uint32_t... second>
+struct concat_index_seq<index_seq<first...>, index_seq<second...> >
+{
+	typedef index_seq<first..., (sizeof...(first) + second)...> type;
+};
+
+template<uint32_t n>
+struct make_index_seq
+{
+	typedef typename concat_index_seq<typename make_index_seq<n / 2>::type, typename make_index_seq<n - n / 2>::type>::type type;
+};
+
+template<>
+struct make_index_seq<0>
+{
+	typedef index_seq<> type;
+};
+
+template<>
+struct make_index_seq<1>
+{
+	typedef index_seq<0> type;
+};
+
+template<typename int_type>
+constexpr int_type constexpr_factorial(uint32_t n)
+{
+	return (n <= 1) ? int_type(1) : int_type(n) * constexpr_factorial<int_type>(n - 1);
+}
+
+template<typename int_type>
+constexpr int_type constexpr_gcd(int_type a, int_type b)
+{
+	return (b == 0) ? a : constexpr_gcd<int_type>(b, a % b);
+}
+
+// result * factor / divisor, which is exact, with the gcd divided out first
+template<typename int_type>
+constexpr int_type constexpr_mul_div(int_type result, int_type factor, int_type divisor, int_type g)
+{
+	return (result / g) * (factor / (divisor / g));
+}
+
+template<typename int_type>
+constexpr int_type constexpr_binomial_next(int_type prev, uint32_t base, uint32_t steps)
+{
+	return (prev <= int_limits<int_type>::max() / int_type(base + steps)) ? prev * int_type(base + steps) / int_type(steps) :
+		constexpr_mul_div<int_type>(prev, int_type(base + steps), int_type(steps), constexpr_gcd<int_type>(prev, int_type(steps)));
+}
+
+// C(base + steps, steps) from C(base + steps - 1, steps - 1), the same way
+// as compute_total_comb, with the gcd only worked out near the top of int_type
+template<typename int_type>
+constexpr int_type constexpr_binomial_by_base(uint32_t base, uint32_t steps)
+{
+	return (steps == 0) ? int_type(1) : constexpr_binomial_next<int_type>(constexpr_binomial_by_base<int_type>(base, steps - 1), base, steps);
+}
+
+// C(n, k) for k <= n
+template<typename int_type>
+constexpr int_type constexpr_binomial(uint32_t n, uint32_t k)
+{
+	return (n - k < k) ? constexpr_binomial_by_base<int_type>(k, n - k) : constexpr_binomial_by_base<int_type>(n - k, k);
+}
+
+// row of entry i of Pascal's triangle laid out row after row, found by
+// bisecting [low, high]
+constexpr uint32_t pascal_row(uint32_t i, uint32_t low = 0, uint32_t high = 0xFFFF)
+{
+	return (low == high) ? low :
+		(((low + high + 1) / 2) * ((low + high + 1) / 2 + 1) / 2 <= i) ? pascal_row(i, (low + high + 1) / 2, high) : pascal_row(i, low, (low + high + 1) / 2 - 1);
+}
+
+template<typename int_type>
+constexpr int_type pascal_entry_in_row(uint32_t i, uint32_t n)
+{
+	return constexpr_binomial<int_type>(n, i - n * (n + 1) / 2);
+}
+
+template<typename int_type>
+constexpr int_type pascal_entry(uint32_t i)
+{
+	return pascal_entry_in_row<int_type>(i, pascal_row(i));
+}
+
+template<typename int_type, typename seq_type>
+struct static_factorials_impl;
+
+template<typename int_type, uint32_t... ns>
+struct static_factorials_impl<int_type, index_seq<ns...> >
+{
+	static constexpr int_type values[sizeof...(ns)] = { constexpr_factorial<int_type>(ns)... };
+};
+
+template<typename int_type, uint32_t... ns>
+constexpr int_type static_factorials_impl<int_type, index_seq<ns...> >::values[sizeof...(ns)];
+
+template<typename int_type, typename seq_type>
+struct static_pascal_impl;
+
+template<typename int_type, uint32_t... ns>
+struct static_pascal_impl<int_type, index_seq<ns...> >
+{
+	static constexpr int_type values[sizeof...(ns)] = { pascal_entry<int_type>(ns)... };
+};
+
+template<typename int_type, uint32_t... ns>
+constexpr int_type static_pascal_impl<int_type, index_seq<ns...> >::values[sizeof...(ns)];
+
+// 0! to max_factorial! and C(n, k) for n <= max_binomial, worked out by the
+// compiler. max_factorial and max_binomial are the largest n which fit in int_type.
+template<typename int_type, uint32_t max_factorial_n, uint32_t max_binomial_n>
+struct native_tables_impl
+{
+	static const bool available = true;
+	static const uint32_t max_factorial = max_factorial_n;
+	static const uint32_t max_binomial = max_binomial_n;
+
+	typedef static_factorials_impl<int_type, typename make_index_seq<max_factorial + 1>::type> factorials_type;
+	typedef static_pascal_impl<int_type, typename make_index_seq<(max_binomial + 1) * (max_binomial + 2) / 2>::type> pascal_type;
+
+	static const int_type* factorials()
+	{
+		return factorials_type::values;
+	}
+	// Pascal's triangle row after row: C(n, k) is at n * (n + 1) / 2 + k
+	static const int_type* pascal()
+	{
+		return pascal_type::values;
+	}
+	static bool factorial(uint32_t n, int_type& result)
+	{
+		if (n > max_factorial)
+			return false;
+		result = factorials_type::values[n];
+		return true;
+	}
+	static bool binomial(uint32_t n, uint32_t k, int_type& result)
+	{
+		if (n > max_binomial || k > n)
+			return false;
+		result = pascal_type::values[n * (n + 1) / 2 + k];
+		return true;
+	}
+};
+
+// Compile-time tables for the native int_types; for any other int_type,
+// such as Boost Multiprecision, available is false and the lookups fail.
+template<typename int_type>
+struct native_tables
+{
+	static const bool available = false;
+	static const uint32_t max_factorial = 0;
+	static const uint32_t max_binomial = 0;
+
+	static const int_type* factorials()
+	{
+		return nullptr;
+	}
+	static const int_type* pascal()
+	{
+		return nullptr;
+	}
+	static bool factorial(uint32_t, int_type&)
+	{
+		return false;
+	}
+	static bool binomial(uint32_t, uint32_t, int_type&)
+	{
+		return false;
+	}
+};
+
+template<> struct native_tables<int32_t> : native_tables_impl<int32_t, 12, 33> {};
+template<> struct native_tables<uint32_t> : native_tables_impl<uint32_t, 12, 34> {};
+template<> struct native_tables<int64_t> : native_tables_impl<int64_t, 20, 66> {};
+template<> struct native_tables<uint64_t> : native_tables_impl<uint64_t, 20, 67> {};
+#if defined(__SIZEOF_INT128__)
+template<> struct native_tables<int128_type> : native_tables_impl<int128_type, 33, 130> {};
+template<> struct native_tables<uint128_type> : native_tables_impl<uint128_type, 34, 131> {};
+#endif
+
+template<typename int_type>
+bool check_positive(const char* name, const int_type& cnt, std::string& error)
+{
+	if (cnt <= 0)
+	{
+		std::ostringstream oss;
+		oss << "Error: " << name << "(" << to_str(cnt);
+		oss << ") <= 0";
+
+		error = oss.str();
+		return false;
+	}
+	return true;
+}
+
+// Carve this cpu's share out of [0, total). On return, the cpu owns
+// [offset, offset + elem_cnt) and thread_cnt is reduced to 1 when there
+// is not enough work to go around.
+template<typename int_type>
+bool split_cpu_range(const int_type& total, const char* total_name,
+	const int_type& cpu_index, const int_type& cpu_cnt, int_type& thread_cnt,
+	int_type& offset, int_type& elem_cnt, std::string& error)
+{
+	if (total < cpu_cnt)
+	{
+		std::ostringstream oss;
+		oss << "Error: " << total_name << "(" << to_str(total);
+		oss << ") < cpu_cnt(" << to_str(cpu_cnt) << ")";
+
+		error = oss.str();
+		return false;
+	}
+
+	elem_cnt = total / cpu_cnt;
+	int_type cpu_remainder = total % cpu_cnt;
+	offset = cpu_index*elem_cnt;
+	if (cpu_index == (cpu_cnt - 1) && cpu_remainder > 0)
+	{
+		elem_cnt += cpu_remainder;
+	}
+
+	if (!check_positive("each_cpu_elem_cnt", elem_cnt, error))
+		return false;
+
+	if (elem_cnt < thread_cnt)
+	{
+		thread_cnt = 1;
+	}
+	return true;
+}
+
+// Launcher which spawns thread_cnt - 1 fresh threads for a single job and
+// joins them at the end; the calling thread does the work of thread 0.
+struct thread_spawner
+{
+	template<typename task_type>
+	void run(int thread_cnt, task_type task)
+	{
+		std::vector<std::shared_ptr<std::thread> > threads;
+		for (int i = 1; i < thread_cnt; ++i)
+		{
+			threads.push_back(std::shared_ptr<std::thread>(new std::thread(task, i)));
+		}
+
+		task(0);
+
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			threads[i]->join();
+		}
+	}
+};
+
+template<typename int_type>
+bool check_pool_thread_cnt(const thread_pool& pool, const int_type& thread_cnt, std::string& error)
+{
+	if (thread_cnt > int_type(pool.thread_cnt()))
+	{
+		std::ostringstream oss;
+		oss << "Error: thread_cnt(" << to_str(thread_cnt);
+		oss << ") > pool thread_cnt(" << pool.thread_cnt() << ")";
+
+		error = oss.str();
+		return false;
+	}
+	return true;
+}
+
+// Give each thread one contiguous slice of [offset, offset + elem_cnt);
+// the last thread takes the remainder. launcher is a thread_spawner or a
+// thread_pool. worker is called as worker(thread_index, start_index, end_index).
+template<typename launcher_type, typename int_type, typename worker_type>
+void run_thread_slices(launcher_type& launcher, const int_type& thread_cnt, const int_type& offset, const int_type& elem_cnt, worker_type worker)
+{
+	int_type each_thread_elem_cnt = elem_cnt / thread_cnt;
+	int_type remainder = elem_cnt % thread_cnt;
+
+	const int thread_cnt_n = static_cast<int>(thread_cnt);
+	std::vector<int_type> start_indices(thread_cnt_n);
+	std::vector<int_type> end_indices(thread_cnt_n);
+	for(int i=0; i<thread_cnt_n; ++i)
+	{
+		int_type bulk = each_thread_elem_cnt;
+		// test for last thread
+		if( i == (thread_cnt_n-1) && remainder > 0 )
+		{
+			bulk += remainder;
+		}
+		start_indices[i] = i * each_thread_elem_cnt + offset;
+		end_indices[i] = start_indices[i] + bulk;
+	}
+
+	launcher.run(thread_cnt_n, [&](int thread_index)
+	{
+		worker(int_type(thread_index), start_indices[thread_index], end_indices[thread_index]);
+	});
+}
+
+// Cut [offset, offset + elem_cnt) into chunk_cnt chunks which the threads
+// claim one at a time until none is left, so a thread stuck on expensive
+// callbacks does not hold up the rest. A worker returning false stops its
+// thread from claiming further chunks.
+template<typename launcher_type, typename int_type, typename worker_type>
+void run_thread_chunks(launcher_type& launcher, const int_type& thread_cnt, int_type chunk_cnt, const int_type& offset, const int_type& elem_cnt, worker_type worker)
+{
+	if (chunk_cnt > elem_cnt)
+	{
+		chunk_cnt = elem_cnt;
+	}
+
+	const uint64_t total_chunks = static_cast<uint64_t>(chunk_cnt);
+	const int_type chunk_size = elem_cnt / chunk_cnt;
+	const int_type remainder = elem_cnt % chunk_cnt; // the first remainder chunks take 1 more
+	std::atomic<uint64_t> next_chunk(0);
+
+	launcher.run(static_cast<int>(thread_cnt), [&](int thread_index)
+	{
+		for (;;)
+		{
+			const uint64_t n = next_chunk.fetch_add(1);
+			if (n >= total_chunks)
+				return;
+
+			const int_type chunk = static_cast<int_type>(n);
+			int_type start_index = offset + chunk * chunk_size;
+			int_type end_index = start_index + chunk_size;
+			if (chunk < remainder)
+			{
+				start_index += chunk;
+				end_index += chunk + 1;
+			}
+			else
+			{
+				start_index += remainder;
+				end_index += remainder;
+			}
+			if (!worker(int_type(thread_index), start_index, end_index))
+				return;
+		}
+	});
+}
+
+// For a slice too big for int64_t counters: cut [start_index, end_index)
+// into consecutive sub-ranges of at most UINT64_MAX results and call
+// loop(cnt) for each, so the worker loop counts [0, cnt) on uint64_t and
+// int_type arithmetic is only done once per sub-range. loop must carry on
+// from where the previous call stopped and return false to stop early.
+// Indices reported by the loop are relative to the sub-range.
+template<typename int_type, typename loop_type>
+bool run_native_sub_ranges(const int_type& start_index, const int_type& end_index, loop_type loop)
+{
+	const uint64_t max_cnt = std::numeric_limits<uint64_t>::max();
+	int_type sub_start = start_index;
+	while (sub_start < end_index)
+	{
+		const int_type remaining = end_index - sub_start;
+		const uint64_t cnt = (remaining < int_type(max_cnt)) ? static_cast<uint64_t>(remaining) : max_cnt;
+		if (!loop(cnt))
+			return false;
+		sub_start += int_type(cnt);
+	}
+	return true;
+}
+
+// Like run_native_sub_ranges for loops which report absolute indices or skip
+// ahead: loop(sub_start, cnt, skip) runs [sub_start, sub_start + cnt), adds
+// sub_start only when reporting or skipping, and sets skip to how far past
+// the end of its sub-range a skip went. The next sub-range starts there, so
+// a long skip costs one call, not one per sub-range it jumps over.
+template<typename int_type, typename loop_type>
+bool run_native_sub_ranges_skipping(const int_type& start_index, const int_type& end_index, loop_type loop)
+{
+	const uint64_t max_cnt = std::numeric_limits<uint64_t>::max();
+	int_type sub_start = start_index;
+	while (sub_start < end_index)
+	{
+		const int_type remaining = end_index - sub_start;
+		const uint64_t cnt = (remaining < int_type(max_cnt)) ? static_cast<uint64_t>(remaining) : max_cnt;
+		int_type skip = 0;
+		if (!loop(static_cast<const int_type&>(sub_start), cnt, skip))
+			return false;
+		sub_start += int_type(cnt) + skip;
+	}
+	return true;
+}
+
+}
@@ -10,19 +10,35 @@
 //
 // version 0.1.0: Initial Release
 // version 0.1.1: More error handling when result count < cpu count
+// version 0.2.0: Added compute_all_perm_chunked for chunked work stealing
+// version 0.3.0: compute_all_perm overloads taking a reusable thread_pool
+// version 0.4.0: find_perm unranks with a factorial_table and leftover_set
+// version 0.5.0: Added compute_all_perm_batched to deliver blocks of permutations
+// version 0.6.0: Added compute_all_perm_sjt for plain changes order
+// version 0.7.0: Added compute_all_perm_idx to permute indices instead of elements
+// version 0.8.0: compute_all_perm overloads taking a cancel_token
+// version 0.9.0: Added compute_all_multiset_perm for elements with duplicates
+// version 0.10.0: Added compute_all_partial_perm for nPr ordered selections
+// version 0.11.0: Added compute_all_perm_pruned to skip permutations by prefix
+// version 0.12.0: Added rank_perm, rank_perm_by_elem and rank_perm_bulk
+// version 0.13.0: Slices past int64_t are counted on uint64_t sub-ranges
+// version 0.14.0: Works with unsigned __int128 as int_type
+// version 0.15.0: Factorials come from compile-time tables for native int_type
+// version 0.16.0: Added compute_all_perm_fixed for std::array of N elements
 
 #pragma once
 
-#include <list>
 #include <vector>
 #include <iterator>
 #include <memory>
 #include <thread>
 #include <functional>
 #include <algorithm>
+#include <array>
 #include <vector>
 #include <cstdint>
 #include <sstream>
+#include "concurrent_common.h"
 
 namespace concurrent_perm
 {
@@ -31,9 +47,15 @@ struct no_predicate_type
 {
 };
 
+// index type permuted by compute_all_perm_idx
+typedef uint8_t perm_index_type;
+
 template<typename int_type>
 void compute_factorial(uint32_t num, int_type& factorial )
 {
+	if (concurrent_permcomb::native_tables<int_type>::factorial(num, factorial))
+		return;
+
 	factorial = 1;
 
 	for( uint32_t i=2; i<=num; ++i )
@@ -42,39 +64,218 @@ void compute_factorial(uint32_t num, int_type& factorial )
 	}
 }
 
-bool remove_element( uint32_t elem, uint32_t& remove_value, std::list<uint32_t>& leftovers )
+// Factorials 0! to max_num!, computed once and shared read-only by all 
+// threads so unranking does not recompute them for every digit.
+template<typename int_type>
+class factorial_table
 {
-	if( leftovers.empty() )
-		return false;
+public:
+	explicit factorial_table(uint32_t max_num)
+		: m_factorials(max_num + 1)
+	{
+		typedef concurrent_permcomb::native_tables<int_type> native;
+		m_factorials[0] = 1;
+		uint32_t i = 1;
+		if (native::available)
+		{
+			// copy what the compiler worked out
+			i = (max_num < native::max_factorial) ? max_num + 1 : native::max_factorial + 1;
+			std::copy(native::factorials(), native::factorials() + i, m_factorials.begin());
+		}
+		for (; i <= max_num; ++i)
+		{
+			m_factorials[i] = m_factorials[i - 1] * i;
+		}
+	}
+	uint32_t max_num() const
+	{
+		return static_cast<uint32_t>(m_factorials.size() - 1);
+	}
+	const int_type& operator[](uint32_t num) const
+	{
+		return m_factorials[num];
+	}
+
+private:
+	std::vector<int_type> m_factorials;
+};
 
-	std::list<uint32_t>::iterator it = leftovers.begin();
+// Position of the k-th (0 based) set bit of mask, with k < popcount(mask).
+// Broadword select: byte-wise prefix popcounts locate the byte holding the
+// bit, then at most 7 lowest bits of that byte are cleared.
+inline uint32_t select_bit(uint64_t mask, uint32_t k)
+{
+	const uint64_t ones_step8 = 0x0101010101010101ULL;
+	const uint64_t msbs_step8 = 0x8080808080808080ULL;
+
+	uint64_t byte_sums = mask - ((mask >> 1) & 0x5555555555555555ULL);
+	byte_sums = (byte_sums & 0x3333333333333333ULL) + ((byte_sums >> 2) & 0x3333333333333333ULL);
+	byte_sums = ((byte_sums + (byte_sums >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * ones_step8;
+
+	// bytes whose inclusive prefix count is <= k come before the bit
+	const uint64_t k_step8 = k * ones_step8;
+	const uint64_t leq_k_step8 = ((k_step8 | msbs_step8) - byte_sums) & msbs_step8;
+	const uint32_t place = static_cast<uint32_t>((((leq_k_step8 >> 7) * ones_step8) >> 56) * 8);
+	uint32_t byte_rank = k - static_cast<uint32_t>(((byte_sums << 8) >> place) & 0xFF);
+
+	uint64_t byte = (mask >> place) & 0xFF;
+	for (; byte_rank > 0; --byte_rank)
+		byte &= byte - 1;
+	return place + concurrent_permcomb::ctz64(byte);
+}
 
-	uint32_t cnt=0;
-	for( ; it!=leftovers.end(); ++it )
+// The numbers [0, set_size) not yet placed in the permutation, supporting
+// removal of the k-th smallest in O(1) for set_size <= 64 (bitmask) and
+// O(log n) above (Fenwick tree).
+class leftover_set
+{
+public:
+	explicit leftover_set(uint32_t set_size)
+		: m_size(set_size)
+		, m_mask(0)
+		, m_top_bit(0)
 	{
-		if( cnt == elem )
+		if (set_size <= 64)
 		{
-			remove_value = *it;
-			leftovers.erase( it );
-			return true;
+			m_mask = (set_size == 64) ? ~uint64_t(0) : ((uint64_t(1) << set_size) - 1);
+			return;
+		}
+
+		// every slot starts with a count of 1, built bottom up in O(n)
+		m_tree.assign(set_size + 1, 0);
+		for (uint32_t i = 1; i <= set_size; ++i)
+		{
+			m_tree[i] += 1;
+			const uint32_t parent = i + (i & (0 - i));
+			if (parent <= set_size)
+				m_tree[parent] += m_tree[i];
+		}
+		m_top_bit = 1;
+		while ((m_top_bit << 1) <= set_size)
+			m_top_bit <<= 1;
+	}
+
+	// removes and returns the k-th (0 based) smallest number left
+	uint32_t take(uint32_t k)
+	{
+		if (m_size <= 64)
+		{
+			const uint32_t value = select_bit(m_mask, k);
+			m_mask &= ~(uint64_t(1) << value);
+			return value;
+		}
+
+		uint32_t pos = 0;
+		for (uint32_t step = m_top_bit; step > 0; step >>= 1)
+		{
+			const uint32_t next = pos + step;
+			if (next <= m_size && m_tree[next] <= k)
+			{
+				pos = next;
+				k -= m_tree[next];
+			}
+		}
+		// pos + 1 is the 1 based slot holding the value
+		for (uint32_t i = pos + 1; i <= m_size; i += (i & (0 - i)))
+			--m_tree[i];
+		return pos;
+	}
+
+	// removes value, which must still be left, and returns how many smaller
+	// numbers are left: the inverse of take
+	uint32_t remove(uint32_t value)
+	{
+		if (m_size <= 64)
+		{
+			const uint64_t bit = uint64_t(1) << value;
+			const uint32_t smaller = concurrent_permcomb::popcount64(m_mask & (bit - 1));
+			m_mask &= ~bit;
+			return smaller;
 		}
 
-		++cnt;
+		uint32_t smaller = 0;
+		for (uint32_t i = value; i > 0; i -= (i & (0 - i)))
+			smaller += m_tree[i];
+		for (uint32_t i = value + 1; i <= m_size; i += (i & (0 - i)))
+			--m_tree[i];
+		return smaller;
+	}
+
+private:
+	uint32_t m_size;
+	uint64_t m_mask;
+	uint32_t m_top_bit;
+	std::vector<uint32_t> m_tree;
+};
+
+// Last set_size digits of find_perm, once index_to_find < set_size! <= 20!
+// fits native integers; switches to 32 bit division below 12!.
+inline void find_perm_native(uint32_t set_size, uint64_t index_to_find, leftover_set& leftovers, std::vector<uint32_t>& results)
+{
+	static const uint64_t factorials[] = { 1ULL, 1ULL, 2ULL, 6ULL, 24ULL, 120ULL, 720ULL, 5040ULL, 40320ULL, 
+		362880ULL, 3628800ULL, 39916800ULL, 479001600ULL, 6227020800ULL, 87178291200ULL, 
+		1307674368000ULL, 20922789888000ULL, 355687428096000ULL, 6402373705728000ULL, 
+		121645100408832000ULL, 2432902008176640000ULL };
+
+	uint32_t i = set_size;
+	for( ; i>12; --i )
+	{
+		const uint64_t digit = index_to_find / factorials[i-1];
+		index_to_find -= digit * factorials[i-1];
+		results.push_back( leftovers.take( static_cast<uint32_t>(digit) ) );
 	}
 
-	return false;
+	uint32_t index32 = static_cast<uint32_t>(index_to_find);
+	for( ; i>0; --i )
+	{
+		const uint32_t factorial = static_cast<uint32_t>(factorials[i-1]);
+		const uint32_t digit = index32 / factorial;
+		index32 -= digit * factorial;
+		results.push_back( leftovers.take( digit ) );
+	}
 }
+
+// Unranks index_to_find through its factorial number system digits: digit i
+// is index / (set_size-1-i)! and picks the digit-th smallest unused number.
+// int_type arithmetic is only used for the digits above 20!.
 template<typename int_type>
-bool find_perm(uint32_t set_size, 
+bool find_perm(const factorial_table<int_type>& factorials,
+			  uint32_t set_size, 
 			  int_type index_to_find, 
-			  std::vector<uint32_t>& results );
+			  std::vector<uint32_t>& results )
+{
+	results.clear();
+
+	if( set_size == 0 || set_size > factorials.max_num() )
+		return false;
+
+	if( index_to_find < 0 || !(index_to_find < factorials[set_size]) )
+		return false;
+
+	results.reserve( set_size );
+	leftover_set leftovers( set_size );
+	uint32_t i=set_size;
+	for( ; i>20; --i )
+	{
+		const int_type& factorial = factorials[i-1];
+		const int_type digit = index_to_find / factorial;
+		index_to_find -= digit * factorial;
+		results.push_back( leftovers.take( static_cast<uint32_t>(digit) ) );
+	}
+	find_perm_native( i, static_cast<uint64_t>(index_to_find), leftovers, results );
+
+	return true;
+}
+
 template<typename int_type, typename vector_type>
-vector_type find_perm_by_idx(int_type index_to_find,
+vector_type find_perm_by_idx(const factorial_table<int_type>& factorials,
+	int_type index_to_find,
 	vector_type& original_vector)
 {
 	std::vector<uint32_t> integer_results;
 	vector_type results;
-	if (find_perm(original_vector.size(),
+	if (find_perm(factorials,
+		original_vector.size(),
 		index_to_find,
 		integer_results))
 	{
@@ -86,56 +287,150 @@ vector_type find_perm_by_idx(int_type index_to_find,
 	return results;
 }
 
+template<typename int_type, typename vector_type>
+vector_type find_perm_by_idx(int_type index_to_find,
+	vector_type& original_vector)
+{
+	factorial_table<int_type> factorials(original_vector.size());
+	return find_perm_by_idx(factorials, index_to_find, original_vector);
+}
+
 template<typename int_type>
 bool find_perm(uint32_t set_size, 
 			  int_type index_to_find, 
 			  std::vector<uint32_t>& results )
 {
-	results.clear();
+	factorial_table<int_type> factorials( set_size );
+	return find_perm( factorials, set_size, index_to_find, results );
+}
+
+// Inverse of find_perm: the lexicographic rank of a permutation of
+// {0 .. n-1}, from its factorial number system digits. Each digit costs
+// O(1) for n <= 64 and O(log n) above, and only the digits above 20! use
+// int_type arithmetic. Returns false if perm is not a permutation.
+template<typename int_type>
+bool rank_perm(const factorial_table<int_type>& factorials,
+			  const std::vector<uint32_t>& perm, 
+			  int_type& rank )
+{
+	const uint32_t set_size = static_cast<uint32_t>(perm.size());
+	if( set_size == 0 || set_size > factorials.max_num() )
+		return false;
 
-	std::list<uint32_t> leftovers;
+	std::vector<char> seen( set_size, 0 );
 	for( uint32_t i=0; i<set_size; ++i )
-		leftovers.push_back( i );
+	{
+		if( perm[i] >= set_size || seen[perm[i]] )
+			return false;
+		seen[perm[i]] = 1;
+	}
 
-	uint32_t prev_size=0;
-	++index_to_find;
-	int_type remaining_index = index_to_find;
-	bool processed = false;
-	while( set_size )
+	leftover_set leftovers( set_size );
+	rank = 0;
+	uint32_t i=0;
+	for( ; set_size-i > 20; ++i )
+	{
+		rank = rank * (set_size-i) + leftovers.remove( perm[i] );
+	}
+	uint64_t low = 0;
+	const uint32_t low_cnt = set_size-i;
+	for( ; i<set_size; ++i )
 	{
-		prev_size = set_size;
-		--set_size;
+		low = low * (set_size-i) + leftovers.remove( perm[i] );
+	}
+	rank = rank * factorials[low_cnt] + static_cast<int_type>(low);
 
-		int_type factorial;
-		compute_factorial( set_size, factorial );
-		int_type prev_mult = 0;
-		for( uint32_t i=1; i<=prev_size; ++i )
-		{
-			int_type pos = factorial * i;
+	return true;
+}
+
+template<typename int_type>
+bool rank_perm(const std::vector<uint32_t>& perm, 
+			  int_type& rank )
+{
+	factorial_table<int_type> factorials( static_cast<uint32_t>(perm.size()) );
+	return rank_perm( factorials, perm, rank );
+}
+
+// Inverse of find_perm_by_idx. original_vector must be sorted ascending
+// with unique elements, as compute_all_perm expects.
+template<typename int_type, typename vector_type>
+bool rank_perm_by_elem(const factorial_table<int_type>& factorials,
+	const vector_type& original_vector,
+	const vector_type& perm,
+	int_type& rank)
+{
+	if (perm.size() != original_vector.size())
+		return false;
+
+	std::vector<uint32_t> integer_perm;
+	integer_perm.reserve(perm.size());
+	for (auto it = perm.begin(); it != perm.end(); ++it)
+	{
+		auto found = std::lower_bound(original_vector.begin(), original_vector.end(), *it);
+		if (found == original_vector.end() || *it < *found)
+			return false;
+		integer_perm.push_back(static_cast<uint32_t>(std::distance(original_vector.begin(), found)));
+	}
+	return rank_perm(factorials, integer_perm, rank);
+}
+
+// Ranks every permutation of perms on thread_cnt threads. ranks[i] is set to
+// int_type(-1), the largest value for an unsigned int_type, for an entry
+// which is not a permutation of original_vector, in which case false is
+// returned. Unlike n!, that always fits int_type and is never a rank.
+template<typename int_type, typename vector_type>
+bool rank_perm_bulk(int_type thread_cnt,
+	const vector_type& original_vector,
+	const std::vector<vector_type>& perms,
+	std::vector<int_type>& ranks)
+{
+	ranks.assign(perms.size(), int_type(0));
+	if (thread_cnt <= 0)
+		return false;
+	if (perms.empty())
+		return true;
 
-			if( remaining_index < pos || remaining_index == pos )
+	const factorial_table<int_type> factorials(static_cast<uint32_t>(original_vector.size()));
+	const int_type perm_cnt = static_cast<int_type>(perms.size());
+	if (perm_cnt < thread_cnt)
+	{
+		thread_cnt = perm_cnt;
+	}
+
+	std::atomic<bool> all_ranked(true);
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, int_type(0), perm_cnt,
+		[&](const int_type& thread_index, const int_type& start_index, const int_type& end_index)
+	{
+		const size_t end_i = static_cast<size_t>(end_index);
+		for (size_t i = static_cast<size_t>(start_index); i < end_i; ++i)
+		{
+			if (!rank_perm_by_elem(factorials, original_vector, perms[i], ranks[i]))
 			{
-				if( prev_mult < remaining_index || prev_mult == remaining_index )
-				{
-					processed = true;
-					remaining_index = remaining_index - prev_mult;
-				}
-
-				uint32_t removed_value=0;
-				remove_element( i-1, removed_value, leftovers );
-				results.push_back( removed_value );
-				break;
+				ranks[i] = static_cast<int_type>(-1);
+				all_ranked.store(false);
 			}
-
-			prev_mult = pos;
 		}
-	}
+	});
+	return all_ranked.load();
+}
+
+template<typename container_type, typename predicate_type>
+typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+next_perm(container_type& cont, predicate_type pred)
+{
+	return std::next_permutation(cont.begin(), cont.end(), pred);
+}
 
-	return processed;
+template<typename container_type, typename predicate_type>
+typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+next_perm(container_type& cont, predicate_type)
+{
+	return std::next_permutation(cont.begin(), cont.end());
 }
 
 template<typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
-typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value>::type 
+typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value, bool>::type 
 perm_loop(const int thread_index, container_type& cont, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback, predicate_type pred)
 {
     index_type j = start;
@@ -144,32 +439,34 @@ perm_loop(const int thread_index, container_type& cont, const index_type& start,
         for (; j < end; ++j)
         {
             if (!callback(thread_index, cont))
-                return;
+                return false;
             std::next_permutation(cont.begin(), cont.end(), pred);
         }
+        return true;
     }
     catch(std::exception& ex)
     {
         std::ostringstream oss;
         oss << "Exception thrown thrown in perm_loop:" << ex.what();
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont, oss.str());
     }
     catch(...)
     {
         std::ostringstream oss;
         oss << "Unknown exception thrown in perm_loop:";
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont, oss.str());
     }
+    return false;
 }
 
 template<typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
-typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value>::type
+typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value, bool>::type
 perm_loop(const int thread_index, container_type& cont, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback, predicate_type pred)
 {
     index_type j = start;
@@ -178,165 +475,254 @@ perm_loop(const int thread_index, container_type& cont, const index_type& start,
         for (; j < end; ++j)
         {
             if (!callback(thread_index, cont))
-                return;
+                return false;
             std::next_permutation(cont.begin(), cont.end());
         }
+        return true;
     }
     catch(std::exception& ex)
     {
         std::ostringstream oss;
         oss << "Exception thrown thrown in perm_loop:" << ex.what();
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont, oss.str());
     }
     catch(...)
     {
         std::ostringstream oss;
         oss << "Unknown exception thrown thrown in perm_loop:";
-        oss << ", start index:" << start;
-        oss << ", end index:" << end;
-        oss << ", counting index:" << j;
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
         err_callback(thread_index, cont, oss.str());
     }
+    return false;
 }
 
-template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
-void worker_thread_proc(const int_type& thread_index, 
-	const container_type& cont,
-	int_type start_index, 
-	int_type end_index, 
-	callback_type callback,
-    error_callback_type err_callback,
-	predicate_type pred)
+// Set vec, a copy of cont, to the permutation at start_index
+template<typename int_type, typename container_type>
+void make_start_perm(const container_type& cont, const factorial_table<int_type>& factorials, const int_type& start_index, container_type& vec)
 {
-	const int thread_index_n = static_cast<const int>(thread_index);
 	std::vector<uint32_t> results;
-	container_type vec(cont.cbegin(), cont.cend());
 	if(start_index>0)
 	{
-		if(concurrent_perm::find_perm(cont.size(), start_index, results))
+		if(concurrent_perm::find_perm(factorials, cont.size(), start_index, results))
 		{
-			container_type vecTemp(cont.cbegin(), cont.cend());
 			for(size_t i=0; i<results.size(); ++i)
 			{
-				vec[i] = vecTemp[ results[i] ];
+				vec[i] = cont[ results[i] ];
 			}
 		}
 	}
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool worker_thread_proc(const int_type& thread_index, 
+	const container_type& cont,
+	const factorial_table<int_type>& factorials,
+	int_type start_index, 
+	int_type end_index, 
+	callback_type callback,
+    error_callback_type err_callback,
+	predicate_type pred)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	container_type vec(cont.cbegin(), cont.cend());
+	make_start_perm(cont, factorials, start_index, vec);
 
 	if (end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
 	{
 		const int start_i = static_cast<int>(start_index);
 		const int end_i   = static_cast<int>(end_index);
-		perm_loop(thread_index_n, vec, start_i, end_i, callback, err_callback, pred);
+		return perm_loop(thread_index_n, vec, start_i, end_i, callback, err_callback, pred);
 	}
 	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
 	{
 		const int64_t start_i = static_cast<int64_t>(start_index);
 		const int64_t end_i = static_cast<int64_t>(end_index);
-		perm_loop(thread_index_n, vec, start_i, end_i, callback, err_callback, pred);
+		return perm_loop(thread_index_n, vec, start_i, end_i, callback, err_callback, pred);
 	}
 	else
 	{
-		perm_loop(thread_index_n, vec, start_index, end_index, callback, err_callback, pred);
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return perm_loop(thread_index_n, vec, uint64_t(0), cnt, callback, err_callback, pred);
+		});
 	}
 }
 
-template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
-bool compute_all_perm_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+// Copies up to block_size consecutive permutations into one flat buffer,
+// set_size elements each, and hands the whole block to callback. The rank of
+// the permutation at counter j is base + j; base is only added for callback.
+template<typename int_type, typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool perm_batched_loop(const int thread_index, container_type& cont, const int_type& base, const index_type& start, const index_type& end, uint32_t block_size, callback_type callback, error_callback_type err_callback, predicate_type pred)
 {
-	if (cpu_cnt <= 0)
-	{
-		std::ostringstream oss;
-		oss << "Error: cpu_cnt(" << cpu_cnt;
-		oss << ") <= 0";
+    typedef typename container_type::value_type value_type;
+    const size_t set_size = cont.size();
+    std::vector<value_type> block(set_size * block_size);
+    index_type j = start;
+    try
+    {
+        while (j < end)
+        {
+            const index_type block_start = j;
+            size_t block_cnt = 0;
+            value_type* dest = block.data();
+            for (; j < end && block_cnt < block_size; ++j, ++block_cnt)
+            {
+                dest = std::copy(cont.begin(), cont.end(), dest);
+                next_perm(cont, pred);
+            }
+            const value_type* block_data = block.data();
+            if (!callback(thread_index, block_data, block_cnt, set_size, base + static_cast<int_type>(block_start)))
+                return false;
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in perm_batched_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in perm_batched_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont, oss.str());
+    }
+    return false;
+}
 
-		err_callback(int_type(0), cont, oss.str());
-		return false;
-	}
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool batched_worker_thread_proc(const int_type& thread_index, 
+	const container_type& cont,
+	const factorial_table<int_type>& factorials,
+	int_type start_index, 
+	int_type end_index, 
+	uint32_t block_size,
+	callback_type callback,
+	error_callback_type err_callback,
+	predicate_type pred)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	container_type vec(cont.cbegin(), cont.cend());
+	make_start_perm(cont, factorials, start_index, vec);
 
-	if (thread_cnt <= 0)
+	if (end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
 	{
-		std::ostringstream oss;
-		oss << "Error: thread_cnt(" << thread_cnt;
-		oss << ") <= 0";
+		const int start_i = static_cast<int>(start_index);
+		const int end_i   = static_cast<int>(end_index);
+		return perm_batched_loop(thread_index_n, vec, int_type(0), start_i, end_i, block_size, callback, err_callback, pred);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return perm_batched_loop(thread_index_n, vec, int_type(0), start_i, end_i, block_size, callback, err_callback, pred);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges_skipping(start_index, end_index, [&](const int_type& sub_start, uint64_t cnt, int_type&) -> bool
+		{
+			return perm_batched_loop(thread_index_n, vec, sub_start, uint64_t(0), cnt, block_size, callback, err_callback, pred);
+		});
+	}
+}
 
-		err_callback(int_type(0), cont, oss.str());
+template<typename int_type, typename container_type, typename error_callback_type>
+bool split_perm_range(const int_type& cpu_index, const int_type& cpu_cnt, int_type& thread_cnt, 
+	const container_type& cont, error_callback_type err_callback, int_type& offset, int_type& each_cpu_elem_cnt)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error))
+	{
+		err_callback(0, cont, error);
 		return false;
 	}
 
 	int_type factorial=0; 
 	compute_factorial(cont.size(), factorial );
 
-	if (factorial < cpu_cnt)
+	if (!concurrent_permcomb::split_cpu_range(factorial, "factorial", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
 	{
-		std::ostringstream oss;
-		oss << "Error: factorial(" << factorial;
-		oss << ") < cpu_cnt(" << cpu_cnt << ")";
-
-		err_callback(int_type(0), cont, oss.str());
+		err_callback(0, cont, error);
 		return false;
 	}
+	return true;
+}
 
-	int_type each_cpu_elem_cnt = factorial / cpu_cnt;
-	int_type cpu_remainder = factorial % cpu_cnt;
-	int_type offset = cpu_index*each_cpu_elem_cnt;
-	if (cpu_index == (cpu_cnt - 1) && cpu_remainder > 0)
-	{
-		each_cpu_elem_cnt += cpu_remainder;
-	}
+template<typename launcher_type, typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool run_perm_shard(launcher_type& launcher, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_perm_range(cpu_index, cpu_cnt, thread_cnt, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
 
-	if (each_cpu_elem_cnt <= 0)
+	const factorial_table<int_type> factorials(cont.size());
+	concurrent_permcomb::run_thread_slices(launcher, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &factorials, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
 	{
-		std::ostringstream oss;
-		oss << "Error: each_cpu_elem_cnt(" << each_cpu_elem_cnt;
-		oss << ") <= 0";
+		return worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, factorials, start_index, end_index, callback, err_callback, pred);
+	});
 
-		err_callback(int_type(0), cont, oss.str());
-		return false;
-	}
+	return true;
+}
 
-	if (each_cpu_elem_cnt < thread_cnt)
+template<typename launcher_type, typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool run_perm_chunked_shard(launcher_type& launcher, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, int_type chunk_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("chunk_cnt", chunk_cnt, error))
 	{
-		thread_cnt = 1;
+		err_callback(0, cont, error);
+		return false;
 	}
 
-	int_type each_thread_elem_cnt = each_cpu_elem_cnt / thread_cnt;
-	int_type remainder = each_cpu_elem_cnt % thread_cnt;
-
-	std::vector<std::shared_ptr<std::thread> > threads;
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_perm_range(cpu_index, cpu_cnt, thread_cnt, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
 
-	int_type bulk = each_thread_elem_cnt;
-	for(int_type i=1; i<thread_cnt; ++i)
+	const factorial_table<int_type> factorials(cont.size());
+	concurrent_permcomb::run_thread_chunks(launcher, thread_cnt, chunk_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &factorials, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
 	{
-		// test for last thread
-		bulk = each_thread_elem_cnt;
-		if( i == (thread_cnt-1) && remainder > 0 )
-		{
-			bulk += remainder;
-		}
-		int_type start_index = i * each_thread_elem_cnt + offset;
-		int_type end_index = start_index + bulk;
-		threads.push_back( std::shared_ptr<std::thread>(new std::thread(
-			std::bind(worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>, i, cont, start_index, end_index, callback, err_callback, pred))));
-	}
+		return worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, factorials, start_index, end_index, callback, err_callback, pred);
+	});
 
-	bulk = each_thread_elem_cnt; // reset remainder
-	int_type start_index = offset;
-	int_type end_index = start_index + bulk;
-	int_type thread_index = 0;
-	worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, start_index, end_index, callback, err_callback, pred);
+	return true;
+}
 
-	for(size_t i=0; i<threads.size(); ++i)
+template<typename int_type, typename container_type, typename error_callback_type>
+bool check_pool(const concurrent_permcomb::thread_pool& pool, const int_type& thread_cnt, const container_type& cont, error_callback_type err_callback)
+{
+	std::string error;
+	if (!concurrent_permcomb::check_pool_thread_cnt(pool, thread_cnt, error))
 	{
-		threads[i]->join();
+		err_callback(0, cont, error);
+		return false;
 	}
-
 	return true;
 }
 
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_perm_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	concurrent_permcomb::thread_spawner spawner;
+	return run_perm_shard(spawner, cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback, pred);
+}
+
 template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
 bool compute_all_perm(int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
 {
@@ -345,4 +731,1344 @@ bool compute_all_perm(int_type thread_cnt, const container_type& cont, callback_
 	return compute_all_perm_shard(cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback, pred);
 }
 
+// Runs on the parked threads of pool instead of spawning new ones.
+// thread_cnt must not exceed pool.thread_cnt().
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_perm_shard(concurrent_permcomb::thread_pool& pool, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	if (!check_pool(pool, thread_cnt, cont, err_callback))
+		return false;
+
+	return run_perm_shard(pool, cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback, pred);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_perm(concurrent_permcomb::thread_pool& pool, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_shard(pool, cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback, pred);
+}
+
+// Stops every thread promptly once token is tripped, either by another
+// thread calling token.cancel() or by callback returning false. Returns
+// run_status::failed if err_callback was called, run_status::cancelled if
+// token was tripped, otherwise run_status::completed.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+concurrent_permcomb::run_status compute_all_perm_shard(concurrent_permcomb::cancel_token& token, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	std::atomic<bool> failed(false);
+	concurrent_permcomb::thread_spawner spawner;
+	run_perm_shard(spawner, cpu_index, cpu_cnt, thread_cnt, cont,
+		concurrent_permcomb::make_cancellable_callback(callback, token),
+		concurrent_permcomb::make_cancelling_err_callback(err_callback, token, failed), pred);
+
+	return concurrent_permcomb::get_run_status(token, failed);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+concurrent_permcomb::run_status compute_all_perm(concurrent_permcomb::cancel_token& token, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_shard(token, cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback, pred);
+}
+
+// Same split across cpus as compute_all_perm_shard, but the cpu's share is cut
+// into chunk_cnt chunks which threads keep claiming until none is left.
+// Returning false from callback stops the current thread from claiming more chunks.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_perm_chunked_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, int_type chunk_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	concurrent_permcomb::thread_spawner spawner;
+	return run_perm_chunked_shard(spawner, cpu_index, cpu_cnt, thread_cnt, chunk_cnt, cont, callback, err_callback, pred);
 }
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_perm_chunked(int_type thread_cnt, int_type chunk_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_chunked_shard(cpu_index, cpu_cnt, thread_cnt, chunk_cnt, cont, callback, err_callback, pred);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_perm_chunked_shard(concurrent_permcomb::thread_pool& pool, int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, int_type chunk_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	if (!check_pool(pool, thread_cnt, cont, err_callback))
+		return false;
+
+	return run_perm_chunked_shard(pool, cpu_index, cpu_cnt, thread_cnt, chunk_cnt, cont, callback, err_callback, pred);
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_perm_chunked(concurrent_permcomb::thread_pool& pool, int_type thread_cnt, int_type chunk_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_chunked_shard(pool, cpu_index, cpu_cnt, thread_cnt, chunk_cnt, cont, callback, err_callback, pred);
+}
+
+// Like compute_all_perm_shard, but callback receives up to block_size
+// permutations at once, laid out back to back in a flat buffer:
+// callback(thread_index, block, block_cnt, set_size, block_start_index)
+// where permutation i of the block starts at block[i * set_size] and has
+// rank block_start_index + i. The buffer is reused for the next block.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_perm_batched_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t block_size, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("block_size", block_size, error))
+	{
+		err_callback(0, cont, error);
+		return false;
+	}
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_perm_range(cpu_index, cpu_cnt, thread_cnt, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const factorial_table<int_type> factorials(cont.size());
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &factorials, block_size, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return batched_worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, factorials, start_index, end_index, block_size, callback, err_callback, pred);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_perm_batched(int_type thread_cnt, uint32_t block_size, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_batched_shard(cpu_index, cpu_cnt, thread_cnt, block_size, cont, callback, err_callback, pred);
+}
+
+// Plain changes (Steinhaus-Johnson-Trotter) order, following Knuth's
+// Algorithm P in TAOCP 7.2.1.2: consecutive permutations differ by one swap
+// of adjacent elements. State is 1 based: element j of the index set
+// {0 .. n-1}, counting from 1, has c[j] smaller elements on its right and
+// moves in direction o[j]. c[j] is digit j of the rank in a reflected
+// mixed radix Gray code, radix j.
+template<typename int_type>
+bool unrank_perm_sjt(uint32_t set_size, int_type index_to_find, std::vector<int>& c, std::vector<int>& o)
+{
+	if (set_size == 0 || index_to_find < 0)
+		return false;
+
+	c.assign(set_size + 1, 0);
+	o.assign(set_size + 1, 1);
+	for (uint32_t j = set_size; j >= 2; --j)
+	{
+		c[j] = static_cast<int>(index_to_find % j);
+		index_to_find /= j;
+	}
+	if (index_to_find != 0) // index_to_find >= set_size!
+		return false;
+
+	// a digit runs backwards when the rank formed by the digits before it is odd
+	bool odd = false;
+	for (uint32_t j = 2; j <= set_size; ++j)
+	{
+		const int digit = c[j];
+		if (odd)
+		{
+			c[j] = static_cast<int>(j) - 1 - digit;
+			o[j] = -1;
+		}
+		odd = ((odd && (j & 1)) != ((digit & 1) != 0));
+	}
+	return true;
+}
+
+// Index permutation of an unranked plain changes state
+inline void perm_sjt_from_state(uint32_t set_size, const std::vector<int>& c, std::vector<uint32_t>& results)
+{
+	results.clear();
+	results.reserve(set_size);
+	for (uint32_t j = 1; j <= set_size; ++j)
+	{
+		results.insert(results.end() - c[j], j - 1);
+	}
+}
+
+// One step of Algorithm P. Returns false after the last permutation,
+// otherwise pos1 and pos2 are the 0 based adjacent positions to swap.
+inline bool next_perm_sjt(uint32_t set_size, std::vector<int>& c, std::vector<int>& o, uint32_t& pos1, uint32_t& pos2)
+{
+	int j = static_cast<int>(set_size);
+	int s = 0; // elements which already went to the far left of their range
+	for (;;)
+	{
+		const int q = c[j] + o[j];
+		if (q == j)
+		{
+			if (j == 1)
+				return false;
+			++s;
+		}
+		else if (q >= 0)
+		{
+			pos1 = static_cast<uint32_t>(j - c[j] + s - 1);
+			pos2 = static_cast<uint32_t>(j - q + s - 1);
+			c[j] = q;
+			return true;
+		}
+		o[j] = -o[j];
+		--j;
+	}
+}
+
+// Finds the permutation at index_to_find in plain changes order; results
+// holds indices into the original set.
+template<typename int_type>
+bool find_perm_sjt(uint32_t set_size, 
+			  int_type index_to_find, 
+			  std::vector<uint32_t>& results )
+{
+	std::vector<int> c;
+	std::vector<int> o;
+	if (!unrank_perm_sjt(set_size, index_to_find, c, o))
+		return false;
+
+	perm_sjt_from_state(set_size, c, results);
+	return true;
+}
+
+// Inverse of find_perm_sjt: rank of an index permutation of {0 .. n-1}
+// in plain changes order.
+template<typename int_type>
+bool rank_perm_sjt(const std::vector<uint32_t>& perm, int_type& rank)
+{
+	const uint32_t set_size = static_cast<uint32_t>(perm.size());
+	std::vector<uint32_t> pos(set_size, set_size);
+	for (uint32_t i = 0; i < set_size; ++i)
+	{
+		if (perm[i] >= set_size || pos[perm[i]] != set_size)
+			return false; // not a permutation
+		pos[perm[i]] = i;
+	}
+
+	rank = 0;
+	bool odd = false;
+	for (uint32_t j = 2; j <= set_size; ++j)
+	{
+		// smaller elements on the right of element j - 1
+		int c = 0;
+		for (uint32_t i = pos[j - 1] + 1; i < set_size; ++i)
+		{
+			if (perm[i] < j - 1)
+				++c;
+		}
+		const int digit = odd ? static_cast<int>(j) - 1 - c : c;
+		rank = rank * j + digit;
+		odd = ((odd && (j & 1)) != ((digit & 1) != 0));
+	}
+	return true;
+}
+
+template<typename int_type, typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool perm_sjt_loop(const int thread_index, container_type& cont, std::vector<int>& c, std::vector<int>& o, uint32_t& pos1, uint32_t& pos2, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    const uint32_t set_size = static_cast<uint32_t>(cont.size());
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, static_cast<const container_type&>(cont), pos1, pos2))
+                return false;
+            if (!next_perm_sjt(set_size, c, o, pos1, pos2))
+                break;
+            std::swap(cont[pos1], cont[pos2]);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in perm_sjt_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in perm_sjt_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont, oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool sjt_worker_thread_proc(const int_type& thread_index, 
+	const container_type& cont,
+	int_type start_index, 
+	int_type end_index, 
+	callback_type callback,
+	error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	const uint32_t set_size = static_cast<uint32_t>(cont.size());
+	std::vector<int> c;
+	std::vector<int> o;
+	std::vector<uint32_t> results;
+	unrank_perm_sjt(set_size, start_index, c, o);
+	perm_sjt_from_state(set_size, c, results);
+
+	container_type vec(cont.cbegin(), cont.cend());
+	for(size_t i=0; i<results.size(); ++i)
+	{
+		vec[i] = cont[ results[i] ];
+	}
+	// kept across sub-ranges, so only the first permutation of the thread
+	// has pos1 == pos2: nothing swapped
+	uint32_t pos1 = 0;
+	uint32_t pos2 = 0;
+
+	if (end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{
+		const int start_i = static_cast<int>(start_index);
+		const int end_i   = static_cast<int>(end_index);
+		return perm_sjt_loop<int_type>(thread_index_n, vec, c, o, pos1, pos2, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return perm_sjt_loop<int_type>(thread_index_n, vec, c, o, pos1, pos2, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return perm_sjt_loop<int_type>(thread_index_n, vec, c, o, pos1, pos2, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// Visits the permutations of cont in plain changes order instead of
+// lexicographic order, so each permutation differs from the one before it
+// by a swap of two adjacent elements:
+// callback(thread_index, cont, swap_pos1, swap_pos2).
+// The first permutation of every thread has swap_pos1 == swap_pos2 since
+// there is no previous permutation to update from. Elements are permuted by
+// position, so equal elements give repeated permutations.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_perm_sjt_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_perm_range(cpu_index, cpu_cnt, thread_cnt, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return sjt_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, start_index, end_index, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_perm_sjt(int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_sjt_shard(cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback);
+}
+
+// Copy of the permutation an index_view stands for, for error reporting
+template<typename container_type, typename index_type>
+container_type view_to_container(const container_type& cont, const std::vector<index_type>& indices)
+{
+	container_type vec(cont.cbegin(), cont.cend());
+	for(size_t i=0; i<indices.size(); ++i)
+	{
+		vec[i] = cont[ indices[i] ];
+	}
+	return vec;
+}
+
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type>
+bool perm_idx_loop(const int thread_index, const container_type& cont, std::vector<perm_index_type>& indices, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback)
+{
+    const concurrent_permcomb::index_view<container_type, perm_index_type> view(cont, indices.data(), indices.size());
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, view))
+                return false;
+            std::next_permutation(indices.begin(), indices.end());
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in perm_idx_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, view_to_container(cont, indices), oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in perm_idx_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, view_to_container(cont, indices), oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool idx_worker_thread_proc(const int_type& thread_index, 
+	const container_type& cont,
+	const factorial_table<int_type>& factorials,
+	int_type start_index, 
+	int_type end_index, 
+	callback_type callback,
+	error_callback_type err_callback)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	std::vector<perm_index_type> indices(cont.size());
+	std::vector<uint32_t> results;
+	if(concurrent_perm::find_perm(factorials, cont.size(), start_index, results))
+	{
+		std::copy(results.begin(), results.end(), indices.begin());
+	}
+
+	if (end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{
+		const int start_i = static_cast<int>(start_index);
+		const int end_i   = static_cast<int>(end_index);
+		return perm_idx_loop(thread_index_n, cont, indices, start_i, end_i, callback, err_callback);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return perm_idx_loop(thread_index_n, cont, indices, start_i, end_i, callback, err_callback);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return perm_idx_loop(thread_index_n, cont, indices, uint64_t(0), cnt, callback, err_callback);
+		});
+	}
+}
+
+// Permutes an array of indices instead of the elements of cont, which is
+// neither copied nor compared. callback(thread_index, view) receives an
+// index_view<container_type, perm_index_type> where view[i] is
+// cont[view.index(i)]. Permutations come in lexicographic order of the
+// indices, the same order compute_all_perm gives for sorted, distinct
+// elements. Sets larger than 256 elements are refused.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_perm_idx_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	const size_t max_set_size = static_cast<size_t>(std::numeric_limits<perm_index_type>::max()) + 1;
+	if (cont.size() > max_set_size)
+	{
+		std::ostringstream oss;
+		oss << "Error: set_size(" << cont.size();
+		oss << ") > " << max_set_size;
+		err_callback(0, cont, oss.str());
+		return false;
+	}
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_perm_range(cpu_index, cpu_cnt, thread_cnt, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const factorial_table<int_type> factorials(cont.size());
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &factorials, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return idx_worker_thread_proc<int_type, container_type, callback_type, error_callback_type>(thread_index, cont, factorials, start_index, end_index, callback, err_callback);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type>
+bool compute_all_perm_idx(int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_idx_shard(cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback);
+}
+
+template<typename value_type, typename predicate_type>
+typename std::enable_if<!std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+elem_less(const value_type& a, const value_type& b, predicate_type pred)
+{
+	return pred(a, b);
+}
+
+template<typename value_type, typename predicate_type>
+typename std::enable_if<std::is_same<predicate_type, no_predicate_type>::value, bool>::type
+elem_less(const value_type& a, const value_type& b, predicate_type)
+{
+	return a < b;
+}
+
+// Number of distinct arrangements of a multiset with group_counts[g] copies
+// of the g-th distinct element: n! / (k1! k2! ... km!), built up as a product
+// of binomials. Each step divides by i before multiplying by placed, after
+// taking out their gcd, so no intermediate value exceeds the result. Returns
+// false when the answer does not fit in int_type.
+template<typename int_type>
+bool compute_total_multiset_perm(const std::vector<uint32_t>& group_counts, int_type& total)
+{
+	int_type result = 1;
+	uint32_t placed = 0;
+	for (size_t g = 0; g < group_counts.size(); ++g)
+	{
+		for (uint32_t i = 1; i <= group_counts[g]; ++i)
+		{
+			++placed;
+			// result * placed / i is exact and i / d shares no factor with placed / d
+			const uint32_t d = concurrent_permcomb::constexpr_gcd<uint32_t>(placed, i);
+			const int_type factor = static_cast<int_type>(placed / d);
+			result /= static_cast<int_type>(i / d);
+			if (concurrent_permcomb::int_limits<int_type>::is_bounded && result > concurrent_permcomb::int_limits<int_type>::max() / factor)
+				return false;
+			result *= factor;
+		}
+	}
+	total = result;
+
+	return true;
+}
+
+// Finds the arrangement at index_to_find in lexicographic order; results
+// holds the group index of every position. Of the total arrangements left,
+// group_counts[g] / remaining of them start with group g.
+template<typename int_type>
+bool find_multiset_perm(const std::vector<uint32_t>& group_counts,
+	int_type index_to_find,
+	std::vector<uint32_t>& results)
+{
+	std::vector<uint32_t> counts(group_counts);
+	uint32_t remaining = 0;
+	for (size_t g = 0; g < counts.size(); ++g)
+	{
+		remaining += counts[g];
+	}
+
+	int_type total = 0;
+	if (!compute_total_multiset_perm(counts, total) || remaining == 0 || index_to_find < 0 || index_to_find >= total)
+		return false;
+
+	results.clear();
+	for (; remaining > 0; --remaining)
+	{
+		for (uint32_t g = 0; g < counts.size(); ++g)
+		{
+			if (counts[g] == 0)
+				continue;
+
+			// total * counts[g] / remaining, divided first so that it cannot overflow
+			const uint32_t d = concurrent_permcomb::constexpr_gcd<uint32_t>(counts[g], remaining);
+			const int_type block = total / static_cast<int_type>(remaining / d) * static_cast<int_type>(counts[g] / d);
+			if (index_to_find < block)
+			{
+				results.push_back(g);
+				total = block;
+				--counts[g];
+				break;
+			}
+			index_to_find -= block;
+		}
+	}
+	return true;
+}
+
+// Sorted copy of cont with the size of every run of equivalent elements
+template<typename container_type, typename predicate_type>
+void group_multiset(const container_type& cont, predicate_type pred, container_type& sorted, std::vector<uint32_t>& group_counts, std::vector<size_t>& group_first)
+{
+	typedef typename container_type::value_type value_type;
+	sorted.assign(cont.cbegin(), cont.cend());
+	std::sort(sorted.begin(), sorted.end(), [pred](const value_type& a, const value_type& b) { return elem_less(a, b, pred); });
+
+	group_counts.clear();
+	group_first.clear();
+	for (size_t i = 0; i < sorted.size(); ++i)
+	{
+		if (i == 0 || elem_less(sorted[i - 1], sorted[i], pred))
+		{
+			group_counts.push_back(0);
+			group_first.push_back(i);
+		}
+		++group_counts.back();
+	}
+}
+
+template<typename int_type, typename vector_type>
+vector_type find_multiset_perm_by_idx(int_type index_to_find,
+	vector_type& original_vector)
+{
+	vector_type sorted;
+	std::vector<uint32_t> group_counts;
+	std::vector<size_t> group_first;
+	group_multiset(original_vector, no_predicate_type(), sorted, group_counts, group_first);
+
+	std::vector<uint32_t> integer_results;
+	vector_type results;
+	if (find_multiset_perm(group_counts, index_to_find, integer_results))
+	{
+		for (uint32_t g : integer_results)
+		{
+			results.push_back(sorted[group_first[g]]);
+		}
+	}
+	return results;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool multiset_worker_thread_proc(const int_type& thread_index, 
+	const container_type& sorted,
+	const std::vector<uint32_t>& group_counts,
+	const std::vector<size_t>& group_first,
+	int_type start_index, 
+	int_type end_index, 
+	callback_type callback,
+	error_callback_type err_callback,
+	predicate_type pred)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	container_type vec(sorted.cbegin(), sorted.cend());
+	std::vector<uint32_t> results;
+	if(start_index>0 && find_multiset_perm(group_counts, start_index, results))
+	{
+		for(size_t i=0; i<results.size(); ++i)
+		{
+			vec[i] = sorted[ group_first[results[i]] ];
+		}
+	}
+
+	if (end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{
+		const int start_i = static_cast<int>(start_index);
+		const int end_i   = static_cast<int>(end_index);
+		return perm_loop(thread_index_n, vec, start_i, end_i, callback, err_callback, pred);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return perm_loop(thread_index_n, vec, start_i, end_i, callback, err_callback, pred);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return perm_loop(thread_index_n, vec, uint64_t(0), cnt, callback, err_callback, pred);
+		});
+	}
+}
+
+// Visits every distinct arrangement of cont exactly once, in lexicographic
+// order starting from the sorted elements, even when cont holds duplicates.
+// Elements are equivalent when neither is less than the other by pred
+// (operator< when no predicate is given).
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_multiset_perm_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error))
+	{
+		err_callback(0, cont, error);
+		return false;
+	}
+
+	container_type sorted;
+	std::vector<uint32_t> group_counts;
+	std::vector<size_t> group_first;
+	group_multiset(cont, pred, sorted, group_counts, group_first);
+
+	int_type total = 0;
+	if (!compute_total_multiset_perm(group_counts, total))
+	{
+		err_callback(0, cont, "Error: total_multiset_perm does not fit int_type");
+		return false;
+	}
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!concurrent_permcomb::split_cpu_range(total, "total_multiset_perm", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
+	{
+		err_callback(0, cont, error);
+		return false;
+	}
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&sorted, &group_counts, &group_first, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return multiset_worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, sorted, group_counts, group_first, start_index, end_index, callback, err_callback, pred);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_multiset_perm(int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_multiset_perm_shard(cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback, pred);
+}
+
+// Number of ordered selections of r out of set_size elements:
+// set_size! / (set_size - r)!. Returns false when r > set_size or when the
+// answer does not fit in int_type.
+template<typename int_type>
+bool compute_total_partial_perm(uint32_t set_size, uint32_t r, int_type& total)
+{
+	if (r > set_size)
+		return false;
+
+	int_type result = 1;
+	for (uint32_t i = set_size - r + 1; i <= set_size; ++i)
+	{
+		const int_type factor = static_cast<int_type>(i);
+		if (concurrent_permcomb::int_limits<int_type>::is_bounded && result > concurrent_permcomb::int_limits<int_type>::max() / factor)
+			return false;
+		result *= factor;
+	}
+	total = result;
+
+	return true;
+}
+
+// Finds the ordered selection at index_to_find in lexicographic order;
+// results holds r indices into the original set. Digit i counts in units
+// of (set_size-1-i)! / (set_size-r)!, the selections sharing the first
+// i + 1 elements.
+template<typename int_type>
+bool find_partial_perm(uint32_t set_size, 
+			  uint32_t r,
+			  int_type index_to_find, 
+			  std::vector<uint32_t>& results )
+{
+	int_type total = 0;
+	if (r == 0 || index_to_find < 0 || !compute_total_partial_perm(set_size, r, total) || index_to_find >= total)
+		return false;
+
+	// every weight divides total, so none of them can overflow
+	std::vector<int_type> weights(r);
+	weights[r - 1] = 1;
+	for (uint32_t i = r - 1; i > 0; --i)
+	{
+		weights[i - 1] = weights[i] * (set_size - i);
+	}
+
+	leftover_set leftovers(set_size);
+	results.clear();
+	results.reserve(r);
+	for (uint32_t i = 0; i < r; ++i)
+	{
+		const int_type digit = index_to_find / weights[i];
+		index_to_find -= digit * weights[i];
+		results.push_back( leftovers.take( static_cast<uint32_t>(digit) ) );
+	}
+	return true;
+}
+
+template<typename int_type, typename vector_type>
+vector_type find_partial_perm_by_idx(uint32_t r,
+	int_type index_to_find,
+	vector_type& original_vector)
+{
+	std::vector<uint32_t> integer_results;
+	vector_type results;
+	if (find_partial_perm(original_vector.size(), r, index_to_find, integer_results))
+	{
+		for (uint32_t n : integer_results)
+		{
+			results.push_back(original_vector.at(n));
+		}
+	}
+	return results;
+}
+
+// vec holds the selection in its first r elements followed by the unused
+// elements in ascending order. Reversing the unused elements makes vec the
+// last arrangement with this selection, so next_permutation moves on to the
+// first arrangement of the next selection.
+template<typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool partial_perm_loop(const int thread_index, container_type& vec, uint32_t r, const index_type& start, const index_type& end, callback_type callback, error_callback_type err_callback, predicate_type pred)
+{
+    container_type partial(vec.begin(), vec.begin() + r);
+    index_type j = start;
+    try
+    {
+        for (; j < end; ++j)
+        {
+            std::copy(vec.begin(), vec.begin() + r, partial.begin());
+            if (!callback(thread_index, static_cast<const container_type&>(partial)))
+                return false;
+            std::reverse(vec.begin() + r, vec.end());
+            next_perm(vec, pred);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in partial_perm_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, partial, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in partial_perm_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, partial, oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool partial_worker_thread_proc(const int_type& thread_index, 
+	const container_type& cont,
+	uint32_t r,
+	int_type start_index, 
+	int_type end_index, 
+	callback_type callback,
+	error_callback_type err_callback,
+	predicate_type pred)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	container_type vec(cont.cbegin(), cont.cend());
+	std::vector<uint32_t> results;
+	if(start_index>0 && find_partial_perm(cont.size(), r, start_index, results))
+	{
+		std::vector<bool> used(cont.size(), false);
+		for(size_t i=0; i<results.size(); ++i)
+		{
+			vec[i] = cont[ results[i] ];
+			used[ results[i] ] = true;
+		}
+		size_t pos = r;
+		for(size_t i=0; i<cont.size(); ++i)
+		{
+			if (!used[i])
+				vec[pos++] = cont[i];
+		}
+	}
+
+	if (end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{
+		const int start_i = static_cast<int>(start_index);
+		const int end_i   = static_cast<int>(end_index);
+		return partial_perm_loop(thread_index_n, vec, r, start_i, end_i, callback, err_callback, pred);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return partial_perm_loop(thread_index_n, vec, r, start_i, end_i, callback, err_callback, pred);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges(start_index, end_index, [&](uint64_t cnt) -> bool
+		{
+			return partial_perm_loop(thread_index_n, vec, r, uint64_t(0), cnt, callback, err_callback, pred);
+		});
+	}
+}
+
+// Visits every ordered selection of r elements of cont (nPr of them) in
+// lexicographic order; callback(thread_index, partial) receives the r
+// selected elements. Like compute_all_perm, cont should be sorted.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_partial_perm_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, uint32_t r, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	std::string error;
+	if (!concurrent_permcomb::check_positive("cpu_cnt", cpu_cnt, error) ||
+		!concurrent_permcomb::check_positive("thread_cnt", thread_cnt, error) ||
+		!concurrent_permcomb::check_positive("r", r, error))
+	{
+		err_callback(0, cont, error);
+		return false;
+	}
+
+	if (r > cont.size())
+	{
+		std::ostringstream oss;
+		oss << "Error: r(" << r << ") > set_size(" << cont.size() << ")";
+		err_callback(0, cont, oss.str());
+		return false;
+	}
+
+	int_type total = 0;
+	if (!compute_total_partial_perm(static_cast<uint32_t>(cont.size()), r, total))
+	{
+		err_callback(0, cont, "Error: total_partial_perm does not fit int_type");
+		return false;
+	}
+
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!concurrent_permcomb::split_cpu_range(total, "total_partial_perm", cpu_index, cpu_cnt, thread_cnt, offset, each_cpu_elem_cnt, error))
+	{
+		err_callback(0, cont, error);
+		return false;
+	}
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, r, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return partial_worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, r, start_index, end_index, callback, err_callback, pred);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_partial_perm(int_type thread_cnt, uint32_t r, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_partial_perm_shard(cpu_index, cpu_cnt, thread_cnt, r, cont, callback, err_callback, pred);
+}
+
+// First position which next_perm is going to change: the element before
+// the longest non-increasing suffix, or 0 when cont is the last permutation.
+template<typename container_type, typename predicate_type>
+uint32_t next_perm_pivot(const container_type& cont, predicate_type pred)
+{
+	typedef typename container_type::value_type value_type;
+	uint32_t i = static_cast<uint32_t>(cont.size());
+	if (i < 2)
+		return 0;
+	for (--i; i > 0; --i)
+	{
+		if (elem_less<value_type>(cont[i - 1], cont[i], pred))
+			return i - 1;
+	}
+	return 0;
+}
+
+// callback(thread_index, cont, changed_pos, prune_len) is told the first
+// position that differs from the previous permutation. Setting prune_len to
+// k skips the rest of the (n-k)! permutations sharing the first k elements:
+// the counter jumps to the start of the next such block, and sorting the
+// suffix in descending order then next_permutation brings cont there.
+// The rank at counter j is base + j, worked out only to skip. A skip past
+// end leaves cont on the block it jumped to and sets skip to how far past.
+template<typename int_type, typename container_type, typename index_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool perm_pruned_loop(const int thread_index, container_type& cont, const factorial_table<int_type>& factorials, const int_type& base, const index_type& start, const index_type& end, uint32_t& changed_pos, int_type& skip, callback_type callback, error_callback_type err_callback, predicate_type pred)
+{
+    typedef typename container_type::value_type value_type;
+    const uint32_t set_size = static_cast<uint32_t>(cont.size());
+    index_type j = start;
+    try
+    {
+        while (j < end)
+        {
+            uint32_t prune_len = 0;
+            if (!callback(thread_index, static_cast<const container_type&>(cont), changed_pos, prune_len))
+                return false;
+
+            if (prune_len > 0 && prune_len < set_size)
+            {
+                const int_type& block_size = factorials[set_size - prune_len];
+                const int_type next_block = ((base + static_cast<int_type>(j)) / block_size + 1) * block_size;
+                const int_type sub_end = base + static_cast<int_type>(end);
+                if (next_block >= sub_end)
+                {
+                    skip = next_block - sub_end;
+                    j = end;
+                }
+                else
+                {
+                    j = static_cast<index_type>(next_block - base);
+                }
+                std::sort(cont.begin() + prune_len, cont.end(), [pred](const value_type& a, const value_type& b) { return elem_less(b, a, pred); });
+            }
+            else
+            {
+                ++j;
+            }
+            changed_pos = next_perm_pivot(cont, pred);
+            next_perm(cont, pred);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in perm_pruned_loop:" << ex.what();
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in perm_pruned_loop:";
+        oss << ", start index:" << concurrent_permcomb::to_str(start);
+        oss << ", end index:" << concurrent_permcomb::to_str(end);
+        oss << ", counting index:" << concurrent_permcomb::to_str(j);
+        err_callback(thread_index, cont, oss.str());
+    }
+    return false;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type>
+bool pruned_worker_thread_proc(const int_type& thread_index, 
+	const container_type& cont,
+	const factorial_table<int_type>& factorials,
+	int_type start_index, 
+	int_type end_index, 
+	callback_type callback,
+	error_callback_type err_callback,
+	predicate_type pred)
+{
+	const int thread_index_n = static_cast<const int>(thread_index);
+	container_type vec(cont.cbegin(), cont.cend());
+	make_start_perm(cont, factorials, start_index, vec);
+	uint32_t changed_pos = 0;
+	int_type skip = 0; // past the end of the slice, so not used
+
+	if (end_index <= std::numeric_limits<int>::max()) // use POD counter when possible
+	{
+		const int start_i = static_cast<int>(start_index);
+		const int end_i   = static_cast<int>(end_index);
+		return perm_pruned_loop(thread_index_n, vec, factorials, int_type(0), start_i, end_i, changed_pos, skip, callback, err_callback, pred);
+	}
+	else if (end_index <= std::numeric_limits<int64_t>::max()) // use POD counter when possible
+	{
+		const int64_t start_i = static_cast<int64_t>(start_index);
+		const int64_t end_i = static_cast<int64_t>(end_index);
+		return perm_pruned_loop(thread_index_n, vec, factorials, int_type(0), start_i, end_i, changed_pos, skip, callback, err_callback, pred);
+	}
+	else
+	{
+		return concurrent_permcomb::run_native_sub_ranges_skipping(start_index, end_index, [&](const int_type& sub_start, uint64_t cnt, int_type& skip) -> bool
+		{
+			return perm_pruned_loop(thread_index_n, vec, factorials, sub_start, uint64_t(0), cnt, changed_pos, skip, callback, err_callback, pred);
+		});
+	}
+}
+
+// Like compute_all_perm_shard, but callback can prune whole prefixes:
+// callback(thread_index, cont, changed_pos, prune_len) where changed_pos is
+// the first position changed since the previous permutation of the thread
+// (0 for its first), and setting prune_len to k skips every later
+// permutation starting with the same k elements. Skips never cross the end
+// of a thread's slice, so the split stays the same as compute_all_perm_shard.
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type=no_predicate_type>
+bool compute_all_perm_pruned_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred=predicate_type())
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_perm_range(cpu_index, cpu_cnt, thread_cnt, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	const factorial_table<int_type> factorials(cont.size());
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, &factorials, callback, err_callback, pred](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		return pruned_worker_thread_proc<int_type, container_type, callback_type, error_callback_type, predicate_type>(thread_index, cont, factorials, start_index, end_index, callback, err_callback, pred);
+	});
+
+	return true;
+}
+
+template<typename int_type, typename container_type, typename callback_type, typename error_callback_type, typename predicate_type = no_predicate_type>
+bool compute_all_perm_pruned(int_type thread_cnt, const container_type& cont, callback_type callback, error_callback_type err_callback, predicate_type pred = predicate_type())
+{
+	int_type cpu_index = 0; 
+	int_type cpu_cnt = 1;
+	return compute_all_perm_pruned_shard(cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback, pred);
+}
+
+// Reverses cont[first, last] with one swap per k in ks, 0 to the half length
+template<size_t first, size_t last, typename value_type, size_t N, uint32_t... ks>
+inline void reverse_fixed(std::array<value_type, N>& cont, concurrent_permcomb::index_seq<ks...>)
+{
+	const int expand[] = { 0, (std::swap(cont[first + ks], cont[last - ks]), 0)... };
+	(void)expand;
+}
+
+// Moves cont to its successor at position i: the next larger element than
+// cont[i] is at N - 1 - digits[i] since the suffix after i is descending,
+// and the suffix is reversed back to ascending.
+template<size_t i, typename value_type, size_t N>
+inline void advance_perm_fixed(std::array<value_type, N>& cont, std::array<uint8_t, N>& digits)
+{
+	std::swap(cont[i], cont[N - 1 - digits[i]]);
+	++digits[i];
+	reverse_fixed<i + 1, N - 1>(cont, typename concurrent_permcomb::make_index_seq<(N - 1 - i) / 2>::type());
+}
+
+// One step of next_perm_fixed per position, from N - 2 down to 0, so the
+// search for the position to advance is unrolled by the compiler
+template<size_t i>
+struct perm_fixed_step
+{
+	template<typename value_type, size_t N>
+	static bool next(std::array<value_type, N>& cont, std::array<uint8_t, N>& digits)
+	{
+		if (digits[i] != N - 1 - i)
+		{
+			advance_perm_fixed<i>(cont, digits);
+			return true;
+		}
+		digits[i] = 0;
+		return perm_fixed_step<i - 1>::next(cont, digits);
+	}
+};
+
+template<>
+struct perm_fixed_step<0>
+{
+	template<typename value_type, size_t N>
+	static bool next(std::array<value_type, N>& cont, std::array<uint8_t, N>& digits)
+	{
+		if (digits[0] != N - 1)
+		{
+			advance_perm_fixed<0>(cont, digits);
+			return true;
+		}
+		digits[0] = 0;
+		reverse_fixed<0, N - 1>(cont, typename concurrent_permcomb::make_index_seq<N / 2>::type());
+		return false;
+	}
+};
+
+// Lexicographic successor of a std::array of N sorted, unique elements,
+// driven by the Lehmer digits of its index instead of comparisons: digits[i]
+// counts the elements after position i which are smaller than cont[i].
+// Every position and suffix length is a constant, so no element is ever
+// compared and there is no loop left to run.
+template<typename value_type, size_t N>
+inline bool next_perm_fixed(std::array<value_type, N>& cont, std::array<uint8_t, N>& digits)
+{
+	return perm_fixed_step<N - 2>::next(cont, digits);
+}
+
+// Lehmer digit is of index_to_find: (index_to_find / (N - 1 - is)!) % (N - is)
+template<size_t N, uint32_t... is>
+inline void lehmer_digits_fixed(uint64_t index_to_find, std::array<uint8_t, N>& digits, concurrent_permcomb::index_seq<is...>)
+{
+	const uint64_t* factorials = concurrent_permcomb::native_tables<uint64_t>::factorials();
+	const int expand[] = { 0, (digits[is] = static_cast<uint8_t>(index_to_find / factorials[N - 1 - is] % (N - is)), 0)... };
+	(void)expand;
+}
+
+// Moves every position after i which is at or above positions[i] one up
+template<size_t i, size_t N, uint32_t... js>
+inline void lehmer_bump_fixed(std::array<uint8_t, N>& positions, concurrent_permcomb::index_seq<js...>)
+{
+	const int expand[] = { 0, (positions[i + 1 + js] += (positions[i + 1 + js] >= positions[i]) ? 1 : 0, 0)... };
+	(void)expand;
+}
+
+// Turns Lehmer digits into positions in the sorted elements, from the last
+// position to the first. A braced list runs its elements in order.
+template<size_t N, uint32_t... is>
+inline void lehmer_positions_fixed(std::array<uint8_t, N>& positions, concurrent_permcomb::index_seq<is...>)
+{
+	const int expand[] = { 0, (lehmer_bump_fixed<N - 1 - is, N>(positions, typename concurrent_permcomb::make_index_seq<is>::type()), 0)... };
+	(void)expand;
+}
+
+template<typename value_type, size_t N, uint32_t... is>
+inline void gather_fixed(const std::array<value_type, N>& sorted, const std::array<uint8_t, N>& positions, std::array<value_type, N>& results, concurrent_permcomb::index_seq<is...>)
+{
+	const int expand[] = { 0, (results[is] = sorted[positions[is]], 0)... };
+	(void)expand;
+}
+
+// Permutation at index_to_find of the sorted elements and its Lehmer
+// digits, using the compile-time factorials. index_to_find must be less
+// than N!. Every step is expanded over the N positions by the compiler.
+template<typename value_type, size_t N>
+void find_perm_fixed(const std::array<value_type, N>& sorted, uint64_t index_to_find, std::array<value_type, N>& results, std::array<uint8_t, N>& digits)
+{
+	typedef typename concurrent_permcomb::make_index_seq<N>::type seq_type;
+	lehmer_digits_fixed(index_to_find, digits, seq_type());
+	std::array<uint8_t, N> positions = digits;
+	lehmer_positions_fixed(positions, seq_type());
+	gather_fixed(sorted, positions, results, seq_type());
+}
+
+// Every run of 6 permutations starting at an index divisible by 6 goes
+// through the 6 orders of the last three elements, so those are visited
+// with fixed swaps and rotations, and next_perm_fixed only runs once per
+// block. The slice ends go through next_perm_fixed one at a time.
+template<typename value_type, size_t N, typename callback_type, typename error_callback_type>
+bool perm_fixed_loop(const int thread_index, const std::array<value_type, N>& start_perm, const std::array<uint8_t, N>& start_digits, uint64_t start, uint64_t end, callback_type callback, error_callback_type err_callback)
+{
+    typedef std::array<value_type, N> array_type;
+    // local copies which nothing else can point to, so the compiler may
+    // keep them in registers across the callback
+    array_type cont = start_perm;
+    std::array<uint8_t, N> digits = start_digits;
+    const array_type& view = cont;
+    uint64_t j = start;
+    try
+    {
+        for (; j < end && j % 6 != 0; ++j)
+        {
+            if (!callback(thread_index, view))
+                return false;
+            next_perm_fixed(cont, digits);
+        }
+        for (; end - j >= 6; j += 6)
+        {
+            // x y z
+            if (!callback(thread_index, view))
+                return false;
+            std::swap(cont[N - 2], cont[N - 1]); // x z y
+            if (!callback(thread_index, view))
+                return false;
+            value_type tmp = cont[N - 3];
+            cont[N - 3] = cont[N - 1];
+            cont[N - 1] = cont[N - 2];
+            cont[N - 2] = tmp; // y x z
+            if (!callback(thread_index, view))
+                return false;
+            std::swap(cont[N - 2], cont[N - 1]); // y z x
+            if (!callback(thread_index, view))
+                return false;
+            tmp = cont[N - 3];
+            cont[N - 3] = cont[N - 2];
+            cont[N - 2] = cont[N - 1];
+            cont[N - 1] = tmp; // z x y
+            if (!callback(thread_index, view))
+                return false;
+            std::swap(cont[N - 2], cont[N - 1]); // z y x
+            if (!callback(thread_index, view))
+                return false;
+            digits[N - 3] = 2;
+            digits[N - 2] = 1;
+            next_perm_fixed(cont, digits);
+        }
+        for (; j < end; ++j)
+        {
+            if (!callback(thread_index, view))
+                return false;
+            next_perm_fixed(cont, digits);
+        }
+        return true;
+    }
+    catch(std::exception& ex)
+    {
+        std::ostringstream oss;
+        oss << "Exception thrown thrown in perm_fixed_loop:" << ex.what();
+        oss << ", start index:" << start;
+        oss << ", end index:" << end;
+        oss << ", counting index:" << j;
+        err_callback(thread_index, view, oss.str());
+    }
+    catch(...)
+    {
+        std::ostringstream oss;
+        oss << "Unknown exception thrown in perm_fixed_loop:";
+        oss << ", start index:" << start;
+        oss << ", end index:" << end;
+        oss << ", counting index:" << j;
+        err_callback(thread_index, view, oss.str());
+    }
+    return false;
+}
+
+// Same as compute_all_perm for N elements known at compile time, which
+// must be sorted and unique. The callback is called as
+// callback(thread_index, const std::array<value_type, N>& cont) and
+// err_callback as err_callback(thread_index, cont, error). 3 to 20 elements
+// run on the fixed engine, counting every index on uint64_t.
+template<typename int_type, typename value_type, size_t N, typename callback_type, typename error_callback_type>
+typename std::enable_if<(N >= 3 && N <= 20), bool>::type
+compute_all_perm_fixed_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const std::array<value_type, N>& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type offset = 0;
+	int_type each_cpu_elem_cnt = 0;
+	if (!split_perm_range(cpu_index, cpu_cnt, thread_cnt, cont, err_callback, offset, each_cpu_elem_cnt))
+		return false;
+
+	concurrent_permcomb::thread_spawner spawner;
+	concurrent_permcomb::run_thread_slices(spawner, thread_cnt, offset, each_cpu_elem_cnt,
+		[&cont, callback, err_callback](const int_type& thread_index, const int_type& start_index, const int_type& end_index) -> bool
+	{
+		const uint64_t start = static_cast<uint64_t>(start_index);
+		const uint64_t end = static_cast<uint64_t>(end_index);
+		std::array<value_type, N> vec;
+		std::array<uint8_t, N> digits;
+		find_perm_fixed(cont, start, vec, digits);
+		return perm_fixed_loop(static_cast<int>(thread_index), vec, digits, start, end, callback, err_callback);
+	});
+
+	return true;
+}
+
+// Fewer than 3 or more than 20 elements fall back to compute_all_perm_shard
+// on a std::vector, with each permutation copied into a std::array for
+// callback. Past 20 elements int_type must hold N!.
+template<typename int_type, typename value_type, size_t N, typename callback_type, typename error_callback_type>
+typename std::enable_if<!(N >= 3 && N <= 20), bool>::type
+compute_all_perm_fixed_shard(int_type cpu_index, int_type cpu_cnt, int_type thread_cnt, const std::array<value_type, N>& cont, callback_type callback, error_callback_type err_callback)
+{
+	typedef std::array<value_type, N> array_type;
+	typedef std::vector<value_type> vector_type;
+	const vector_type vec(cont.cbegin(), cont.cend());
+	return compute_all_perm_shard(cpu_index, cpu_cnt, thread_cnt, vec,
+		[callback](const int thread_index, const vector_type& vec) mutable -> bool
+	{
+		array_type arr;
+		std::copy(vec.cbegin(), vec.cend(), arr.begin());
+		return callback(thread_index, static_cast<const array_type&>(arr));
+	},
+		[err_callback](const int thread_index, const vector_type& vec, const std::string& error) mutable -> void
+	{
+		array_type arr;
+		std::copy(vec.cbegin(), vec.cend(), arr.begin());
+		err_callback(thread_index, static_cast<const array_type&>(arr), error);
+	});
+}
+
+template<typename int_type, typename value_type, size_t N, typename callback_type, typename error_callback_type>
+bool compute_all_perm_fixed(int_type thread_cnt, const std::array<value_type, N>& cont, callback_type callback, error_callback_type err_callback)
+{
+	int_type cpu_index = 0;
+	int_type cpu_cnt = 1;
+	return compute_all_perm_fixed_shard(cpu_index, cpu_cnt, thread_cnt, cont, callback, err_callback);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////////
+// thread_pool.h header file
+//
+// Thread pool reused across Concurrent Permutation and Combination calls
+// Copyright 2016 Wong Shao Voon
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+// version 0.1.0: Initial Release
+// version 0.2.0: run() called from one of the pool's own tasks runs inline
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+namespace concurrent_permcomb
+{
+
+// Keeps thread_cnt - 1 worker threads parked between jobs. Like the
+// compute_all_* functions, the thread calling run() does the work of
+// thread 0, so a pool of thread_cnt runs thread_cnt tasks at once.
+// Jobs submitted from several threads are run one after another. A job
+// submitted from one of the running job's tasks cannot wait for the busy
+// threads, so its tasks run one after another on the submitting thread.
+class thread_pool
+{
+public:
+	explicit thread_pool(int thread_cnt)
+		: m_thread_cnt(thread_cnt > 0 ? thread_cnt : 1)
+		, m_task(nullptr)
+		, m_job_thread_cnt(0)
+		, m_pending(0)
+		, m_generation(0)
+		, m_stop(false)
+	{
+		for (int i = 1; i < m_thread_cnt; ++i)
+		{
+			m_threads.push_back(std::shared_ptr<std::thread>(new std::thread(&thread_pool::worker_proc, this, i)));
+		}
+	}
+
+	~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_work_cv.notify_all();
+
+		for (size_t i = 0; i < m_threads.size(); ++i)
+		{
+			m_threads[i]->join();
+		}
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	int thread_cnt() const
+	{
+		return m_thread_cnt;
+	}
+
+	// True when called from a task of the running job, on a pool thread or
+	// on the thread which called run().
+	bool in_job() const
+	{
+		const std::thread::id id = std::this_thread::get_id();
+		for (size_t i = 0; i < m_threads.size(); ++i)
+		{
+			if (m_threads[i]->get_id() == id)
+				return true;
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_job_owner == id;
+	}
+
+	// Calls task(thread_index) for every thread_index in [0, thread_cnt) and
+	// returns after all of them finish. The first exception thrown by a task
+	// is rethrown here.
+	void run(int thread_cnt, const std::function<void(int)>& task)
+	{
+		if (thread_cnt > m_thread_cnt)
+			thread_cnt = m_thread_cnt;
+
+		if (in_job())
+		{
+			// re-entered from a task: waiting for m_job_mutex would deadlock
+			int i = 0;
+			do
+			{
+				task(i);
+			} while (++i < thread_cnt);
+			return;
+		}
+
+		std::lock_guard<std::mutex> job_lock(m_job_mutex);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job_owner = std::this_thread::get_id();
+			m_error = nullptr;
+			if (thread_cnt > 1)
+			{
+				m_task = &task;
+				m_job_thread_cnt = thread_cnt;
+				m_pending = thread_cnt - 1;
+				++m_generation;
+			}
+		}
+		if (thread_cnt > 1)
+			m_work_cv.notify_all();
+
+		std::exception_ptr error;
+		try
+		{
+			task(0);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done_cv.wait(lock, [this] { return m_pending == 0; });
+		m_task = nullptr;
+		m_job_owner = std::thread::id();
+		if (!error)
+			error = m_error;
+		lock.unlock();
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+private:
+	void worker_proc(int thread_index)
+	{
+		uint64_t generation = 0;
+		for (;;)
+		{
+			const std::function<void(int)>* task = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_work_cv.wait(lock, [this, generation] { return m_stop || m_generation != generation; });
+				if (m_stop)
+					return;
+
+				generation = m_generation;
+				if (thread_index >= m_job_thread_cnt)
+					continue; // not needed for this job
+				task = m_task;
+			}
+
+			std::exception_ptr error;
+			try
+			{
+				(*task)(thread_index);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (error && !m_error)
+				m_error = error;
+			if (--m_pending == 0)
+				m_done_cv.notify_one();
+		}
+	}
+
+	const int m_thread_cnt;
+	std::vector<std::shared_ptr<std::thread> > m_threads;
+
+	std::mutex m_job_mutex;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_work_cv;
+	std::condition_variable m_done_cv;
+
+	const std::function<void(int)>* m_task;
+	int m_job_thread_cnt;
+	int m_pending;
+	uint64_t m_generation;
+	bool m_stop;
+	std::exception_ptr m_error;
+	std::thread::id m_job_owner;
+};
+
+}